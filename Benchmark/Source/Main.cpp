@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Headless benchmark for Tone and ToneBank. Renders synthetic note streams
+    across a matrix of polyphony levels, waveforms, block sizes and sample
+    rates and prints the timings as JSON.
+
+    Usage: hw4Benchmark [--seconds=1] [--quick] [--workers=0] [--output=file.json]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/MIDISynth.h"
+
+namespace
+{
+    struct Settings
+    {
+        double secondsPerRun = 1.0;
+        bool quick = false;
+        int numWorkers = 0;
+        juce::String outputPath;
+    };
+
+    const char* waveTypeName (Tone::WaveType waveType)
+    {
+        switch (waveType)
+        {
+            case Tone::Square:   return "square";
+            case Tone::Sawtooth: return "sawtooth";
+            default:             return "sine";
+        }
+    }
+
+    const char* oscillatorModeName (Tone::OscillatorMode mode)
+    {
+        switch (mode)
+        {
+            case Tone::WavetableLinear: return "wavetableLinear";
+            case Tone::WavetableCubic:  return "wavetableCubic";
+            default:                    return "direct";
+        }
+    }
+
+    const char* instructionSetName (SIMDToneEngine::InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+            case SIMDToneEngine::InstructionSet::sse2:   return "sse2";
+            case SIMDToneEngine::InstructionSet::avx2:   return "avx2";
+            case SIMDToneEngine::InstructionSet::avx512: return "avx512";
+            default:                                     return "scalar";
+        }
+    }
+
+    // Spreads the synthetic note stream over every note of every channel, so up to 2048 voices get distinct keys
+    void noteOn (ToneBank& bank, int note, Tone::WaveType waveType)
+    {
+        bank.noteOn (1 + (note / ToneBank::numMidiNotes) % ToneBank::numMidiChannels, note % ToneBank::numMidiNotes, 100.0f / 127.0f, waveType);
+    }
+
+    void noteOff (ToneBank& bank, int note)
+    {
+        bank.noteOff (1 + (note / ToneBank::numMidiNotes) % ToneBank::numMidiChannels, note % ToneBank::numMidiNotes);
+    }
+
+    double percentile (const std::vector<double>& sorted, double fraction)
+    {
+        const auto index = (size_t) juce::jlimit (0.0, (double) sorted.size() - 1.0, std::ceil (fraction * (double) sorted.size()) - 1.0);
+        return sorted[index];
+    }
+
+    //==============================================================================
+    // Single tone, one processSample() call per sample as the plugin used to do
+    juce::var benchmarkTone (Tone::WaveType waveType, Tone::OscillatorMode mode, double sampleRate, const Settings& settings)
+    {
+        Tone tone;
+        tone.start (440.0f, 100.0f, waveType, sampleRate, EnvelopeCoefficients::calculate ({}, sampleRate));
+        tone.setOscillatorMode (mode);
+
+        const auto numSamples = (int) (settings.secondsPerRun * sampleRate);
+        float sink = 0.0f;
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float sample = 0.0f;
+            tone.processSample (sample);
+            sink += sample;
+        }
+
+        const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("waveform", waveTypeName (waveType));
+        result->setProperty ("oscillatorMode", oscillatorModeName (mode));
+        result->setProperty ("sampleRate", sampleRate);
+        result->setProperty ("nsPerSample", seconds * 1.0e9 / numSamples);
+        result->setProperty ("checksum", sink);
+        return juce::var (result);
+    }
+
+    //==============================================================================
+    struct BankRun
+    {
+        int voices;
+        Tone::WaveType waveType;
+        int blockSize;
+        double sampleRate;
+        bool useSIMDEngine;
+    };
+
+    // Holds `voices` notes and, every block, releases the oldest and starts a new one in place of
+    // the longest-released tone, so the voice count stays at the polyphony
+    juce::var benchmarkToneBank (const BankRun& run, const Settings& settings)
+    {
+        ToneBank bank;
+        bank.setPolyphony (run.voices);
+        bank.setStealingPolicy (ToneBank::StealingPolicy::releasedFirst);
+        bank.setParallelRendering (settings.numWorkers, 2 * ToneBank::parallelVoicesPerChunk);
+        bank.prepareToPlay (run.sampleRate, run.blockSize);
+        bank.setWaveType (run.waveType);
+        bank.setUseSIMDEngine (run.useSIMDEngine);
+        EnvelopeParameters envelope;
+        envelope.releaseMilliseconds = 2000.0;
+        bank.setEnvelope (envelope);
+
+        for (int note = 0; note < run.voices; ++note)
+            noteOn (bank, note, run.waveType);
+
+        juce::AudioBuffer<float> buffer (2, run.blockSize);
+        const auto numBlocks = juce::jmax (1, (int) (settings.secondsPerRun * run.sampleRate / run.blockSize));
+
+        std::vector<double> blockSeconds;
+        blockSeconds.reserve ((size_t) numBlocks);
+
+        double totalSeconds = 0.0, voiceSamples = 0.0;
+        int peakVoices = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            noteOff (bank, block);
+            noteOn (bank, block + run.voices, run.waveType);
+            bank.renderBuffer (buffer);
+
+            const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+            blockSeconds.push_back (seconds);
+            totalSeconds += seconds;
+            voiceSamples += (double) bank.getNumActiveVoices() * run.blockSize;
+            peakVoices = juce::jmax (peakVoices, bank.getNumActiveVoices());
+        }
+
+        std::sort (blockSeconds.begin(), blockSeconds.end());
+
+        const auto audioSeconds = (double) numBlocks * run.blockSize / run.sampleRate;
+
+        auto* blockTimes = new juce::DynamicObject();
+        blockTimes->setProperty ("p50", percentile (blockSeconds, 0.50) * 1.0e6);
+        blockTimes->setProperty ("p90", percentile (blockSeconds, 0.90) * 1.0e6);
+        blockTimes->setProperty ("p99", percentile (blockSeconds, 0.99) * 1.0e6);
+        blockTimes->setProperty ("max", blockSeconds.back() * 1.0e6);
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("requestedVoices", run.voices);
+        result->setProperty ("peakVoices", peakVoices);
+        result->setProperty ("waveform", waveTypeName (run.waveType));
+        result->setProperty ("blockSize", run.blockSize);
+        result->setProperty ("sampleRate", run.sampleRate);
+        result->setProperty ("engine", run.useSIMDEngine ? "simd" : "tones");
+        result->setProperty ("nsPerSamplePerVoice", voiceSamples > 0.0 ? totalSeconds * 1.0e9 / voiceSamples : 0.0);
+        result->setProperty ("realtimeFactor", audioSeconds / totalSeconds);
+        result->setProperty ("blockMicroseconds", juce::var (blockTimes));
+        return juce::var (result);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    Settings settings;
+    settings.quick = args.containsOption ("--quick");
+
+    if (args.containsOption ("--seconds"))
+        settings.secondsPerRun = juce::jmax (0.01, args.getValueForOption ("--seconds").getDoubleValue());
+
+    if (args.containsOption ("--workers"))
+        settings.numWorkers = juce::jmax (0, args.getValueForOption ("--workers").getIntValue());
+
+    if (args.containsOption ("--output"))
+        settings.outputPath = args.getValueForOption ("--output");
+
+    const std::vector<int> polyphonyLevels { 1, 5, 64, 256, 1024 };
+    const std::vector<Tone::WaveType> waveTypes { Tone::Sine, Tone::Square, Tone::Sawtooth };
+    const std::vector<Tone::OscillatorMode> modes { Tone::Direct, Tone::WavetableLinear, Tone::WavetableCubic };
+    const auto blockSizes = settings.quick ? std::vector<int> { 512 } : std::vector<int> { 32, 128, 512, 2048 };
+    const auto sampleRates = settings.quick ? std::vector<double> { 48000.0 } : std::vector<double> { 44100.0, 48000.0, 96000.0 };
+
+    juce::Array<juce::var> toneResults, bankResults;
+
+    for (auto waveType : waveTypes)
+        for (auto mode : modes)
+            toneResults.add (benchmarkTone (waveType, mode, 48000.0, settings));
+
+    for (auto voices : polyphonyLevels)
+        for (auto waveType : waveTypes)
+            for (auto blockSize : blockSizes)
+                for (auto sampleRate : sampleRates)
+                    for (auto useSIMDEngine : { true, false })
+                    {
+                        std::cerr << "voices " << voices << ", " << waveTypeName (waveType) << ", block " << blockSize
+                                  << ", " << sampleRate << " Hz, " << (useSIMDEngine ? "simd" : "tones") << std::endl;
+
+                        bankResults.add (benchmarkToneBank ({ voices, waveType, blockSize, sampleRate, useSIMDEngine }, settings));
+                    }
+
+    auto* system = new juce::DynamicObject();
+    system->setProperty ("cpu", juce::SystemStats::getCpuModel());
+    system->setProperty ("numCpus", juce::SystemStats::getNumCpus());
+    system->setProperty ("instructionSet", instructionSetName (SIMDToneEngine::getBestInstructionSet()));
+    system->setProperty ("workers", settings.numWorkers);
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty ("system", juce::var (system));
+    report->setProperty ("secondsPerRun", settings.secondsPerRun);
+    report->setProperty ("tone", toneResults);
+    report->setProperty ("toneBank", bankResults);
+
+    const auto json = juce::JSON::toString (juce::var (report));
+
+    if (settings.outputPath.isNotEmpty())
+    {
+        if (! juce::File::getCurrentWorkingDirectory().getChildFile (settings.outputPath).replaceWithText (json))
+        {
+            std::cerr << "Couldn't write " << settings.outputPath << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << json << std::endl;
+    }
+
+    return 0;
+}
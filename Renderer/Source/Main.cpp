@@ -0,0 +1,385 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Offline batch renderer. Plays Standard MIDI Files through
+    Hw4AudioProcessor in large blocks, as fast as the CPU allows, and streams
+    the result to WAV or FLAC. Files are shared out between worker threads,
+    each with its own processor, so a long list keeps every core busy.
+
+    With --stems the synth runs multi-timbral with all sixteen part outputs
+    enabled, and each part is written to its own file.
+
+    Builds with HW4_TRACING also take --trace=<file>, which records a
+    Chrome trace of the whole batch.
+
+    Usage: hw4Renderer [--threads=<cpus>] [--block=4096] [--rate=48000]
+                       [--format=wav|flac] [--bits=24] [--tail=10]
+                       [--program=0] [--stems] [--output-dir=.]
+                       file.mid...
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/TraceRecorder.h"
+
+namespace
+{
+    struct Settings
+    {
+        int numThreads = juce::SystemStats::getNumCpus();
+        int blockSize = 4096;
+        double sampleRate = 48000.0;
+        juce::String format = "wav";
+        int bitsPerSample = 24;
+        double maxTailSeconds = 10.0;
+        int program = -1;
+        bool stems = false;
+        juce::File outputDirectory = juce::File::getCurrentWorkingDirectory();
+    };
+
+    struct RenderResult
+    {
+        juce::String error;
+        double audioSeconds = 0.0;
+        double renderSeconds = 0.0;
+    };
+
+    constexpr int outputBufferBytes = 1 << 20;
+
+    bool readMidiFile (const juce::File& file, juce::MidiMessageSequence& sequence, juce::String& error)
+    {
+        juce::FileInputStream stream (file);
+
+        if (! stream.openedOk())
+        {
+            error = "couldn't open the file";
+            return false;
+        }
+
+        juce::MidiFile midiFile;
+
+        if (! midiFile.readFrom (stream))
+        {
+            error = "not a Standard MIDI File";
+            return false;
+        }
+
+        // Tempo maps are applied here, so from now on every timestamp is in seconds
+        midiFile.convertTimestampTicksToSeconds();
+
+        for (int track = 0; track < midiFile.getNumTracks(); ++track)
+            sequence.addSequence (*midiFile.getTrack (track), 0.0);
+
+        return true;
+    }
+
+    //==============================================================================
+    class FileWriters
+    {
+    public:
+        // One writer per output file: the main output, or one per part when rendering stems
+        bool open (const juce::File& source, int numFiles, int numChannels, const Settings& settings, juce::String& error)
+        {
+            auto& format = settings.format == "flac" ? static_cast<juce::AudioFormat&> (flacFormat)
+                                                     : static_cast<juce::AudioFormat&> (wavFormat);
+
+            for (int index = 0; index < numFiles; ++index)
+            {
+                const auto name = source.getFileNameWithoutExtension()
+                                + (numFiles > 1 ? ".part" + juce::String (index + 1) : juce::String())
+                                + format.getFileExtensions()[0];
+                const auto file = settings.outputDirectory.getChildFile (name);
+                file.deleteFile();
+
+                // Large buffered writes; the writer takes ownership of the stream once it exists
+                auto stream = std::make_unique<juce::FileOutputStream> (file, outputBufferBytes);
+
+                if (! stream->openedOk())
+                {
+                    error = "couldn't create " + file.getFullPathName();
+                    return false;
+                }
+
+                std::unique_ptr<juce::AudioFormatWriter> writer (format.createWriterFor (stream.get(), settings.sampleRate,
+                                                                                        (unsigned int) numChannels,
+                                                                                        settings.bitsPerSample, {}, 0));
+
+                if (writer == nullptr)
+                {
+                    error = "can't write " + juce::String (settings.bitsPerSample) + "-bit " + format.getFormatName();
+                    return false;
+                }
+
+                stream.release();
+                writers.push_back (std::move (writer));
+            }
+
+            return true;
+        }
+
+        bool write (Hw4AudioProcessor& processor, juce::AudioBuffer<float>& buffer, int numSamples)
+        {
+            if (writers.size() == 1)
+                return writers.front()->writeFromAudioSampleBuffer (buffer, 0, numSamples);
+
+            for (size_t index = 0; index < writers.size(); ++index)
+            {
+                // Views onto the part's channels, nothing is copied
+                const auto bus = processor.getBusBuffer (buffer, false, (int) index);
+
+                if (! writers[index]->writeFromAudioSampleBuffer (bus, 0, numSamples))
+                    return false;
+            }
+
+            return true;
+        }
+
+    private:
+        juce::WavAudioFormat wavFormat;
+        juce::FlacAudioFormat flacFormat;
+        std::vector<std::unique_ptr<juce::AudioFormatWriter>> writers;
+    };
+
+    //==============================================================================
+    RenderResult renderFile (Hw4AudioProcessor& processor, const juce::File& source, const Settings& settings)
+    {
+        RenderResult result;
+        juce::MidiMessageSequence sequence;
+
+        if (! readMidiFile (source, sequence, result.error))
+            return result;
+
+        const int numBuses = settings.stems ? processor.getBusCount (false) : 1;
+        const int numChannels = settings.stems ? 2 : processor.getMainBusNumOutputChannels();
+
+        FileWriters writers;
+
+        if (! writers.open (source, numBuses, numChannels, settings, result.error))
+            return result;
+
+        // Each file starts from silence, with every channel's controllers and program at their defaults
+        processor.reset();
+
+        juce::MidiBuffer midi;
+
+        for (int channel = 1; channel <= 16; ++channel)
+        {
+            midi.addEvent (juce::MidiMessage::controllerEvent (channel, 121, 0), 0);
+            midi.addEvent (juce::MidiMessage::programChange (channel, 0), 0);
+        }
+
+        juce::AudioBuffer<float> buffer (processor.getTotalNumOutputChannels(), settings.blockSize);
+
+        const auto endSample = (juce::int64) std::ceil (sequence.getEndTime() * settings.sampleRate);
+        const auto lastSample = endSample + (juce::int64) (settings.maxTailSeconds * settings.sampleRate);
+        juce::int64 position = 0;
+        int nextEvent = 0;
+
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+
+        // Play past the last event until the release tails have died away
+        while (position < endSample || (processor.getToneBank().getNumActiveVoices() > 0 && position < lastSample))
+        {
+            const int numSamples = settings.blockSize;
+
+            for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+            {
+                const auto& message = sequence.getEventPointer (nextEvent)->message;
+                const auto eventSample = (juce::int64) std::llround (message.getTimeStamp() * settings.sampleRate);
+
+                if (eventSample >= position + numSamples)
+                    break;
+
+                if (! message.isMetaEvent())
+                    midi.addEvent (message, (int) juce::jmax ((juce::int64) 0, eventSample - position));
+            }
+
+            processor.processBlock (buffer, midi);
+            midi.clear();
+
+            if (! writers.write (processor, buffer, numSamples))
+            {
+                result.error = "write failed";
+                return result;
+            }
+
+            position += numSamples;
+        }
+
+        result.renderSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+        result.audioSeconds = (double) position / settings.sampleRate;
+        return result;
+    }
+
+    //==============================================================================
+    class RenderThread  : public juce::Thread
+    {
+    public:
+        RenderThread (Hw4AudioProcessor& processorToUse, const juce::Array<juce::File>& filesToRender,
+                      std::vector<RenderResult>& resultsToFill, std::atomic<int>& nextFileToRender, const Settings& renderSettings)
+            : juce::Thread ("Render"), processor (processorToUse), files (filesToRender),
+              results (resultsToFill), nextFile (nextFileToRender), settings (renderSettings)
+        {
+        }
+
+        void run() override
+        {
+            // Whichever thread finishes first takes the next file, so long and short files balance out
+            for (int index = nextFile++; index < files.size(); index = nextFile++)
+                results[(size_t) index] = renderFile (processor, files.getReference (index), settings);
+        }
+
+    private:
+        Hw4AudioProcessor& processor;
+        const juce::Array<juce::File>& files;
+        std::vector<RenderResult>& results;
+        std::atomic<int>& nextFile;
+        const Settings& settings;
+    };
+
+    std::unique_ptr<Hw4AudioProcessor> createProcessor (const Settings& settings)
+    {
+        auto processor = std::make_unique<Hw4AudioProcessor>();
+
+        if (settings.stems)
+        {
+            processor->enableAllBuses();
+
+            if (auto* parameter = processor->getParameters().getParameter (ParameterIDs::multiTimbral.getParamID()))
+                parameter->setValueNotifyingHost (1.0f);
+        }
+
+        // setCurrentProgram() keeps the multi-timbral setting, so it has to come second
+        if (settings.program >= 0)
+            processor->setCurrentProgram (settings.program);
+
+        processor->setNonRealtime (true);
+        processor->setRateAndBufferSizeDetails (settings.sampleRate, settings.blockSize);
+        processor->prepareToPlay (settings.sampleRate, settings.blockSize);
+        return processor;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor's parameters want a message manager, even though nothing here runs a message loop
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args (argc, argv);
+
+    Settings settings;
+    settings.stems = args.containsOption ("--stems");
+
+    if (args.containsOption ("--threads"))
+        settings.numThreads = juce::jmax (1, args.getValueForOption ("--threads").getIntValue());
+
+    if (args.containsOption ("--block"))
+        settings.blockSize = juce::jlimit (32, 65536, args.getValueForOption ("--block").getIntValue());
+
+    if (args.containsOption ("--rate"))
+        settings.sampleRate = juce::jlimit (8000.0, 384000.0, args.getValueForOption ("--rate").getDoubleValue());
+
+    if (args.containsOption ("--format"))
+        settings.format = args.getValueForOption ("--format").toLowerCase();
+
+    if (args.containsOption ("--bits"))
+        settings.bitsPerSample = args.getValueForOption ("--bits").getIntValue();
+
+    if (args.containsOption ("--tail"))
+        settings.maxTailSeconds = juce::jmax (0.0, args.getValueForOption ("--tail").getDoubleValue());
+
+    if (args.containsOption ("--program"))
+        settings.program = args.getValueForOption ("--program").getIntValue();
+
+    if (args.containsOption ("--output-dir"))
+        settings.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output-dir"));
+
+    juce::Array<juce::File> files;
+
+    for (const auto& argument : args.arguments)
+        if (! argument.isOption())
+            files.add (argument.resolveAsFile());
+
+    if (files.isEmpty() || (settings.format != "wav" && settings.format != "flac"))
+    {
+        std::cerr << "Usage: hw4Renderer [--threads=N] [--block=4096] [--rate=48000] [--format=wav|flac] [--bits=24]"
+                     " [--tail=10] [--program=N] [--stems] [--output-dir=dir] file.mid..." << std::endl;
+        return 1;
+    }
+
+    if (! settings.outputDirectory.createDirectory())
+    {
+        std::cerr << "Couldn't create " << settings.outputDirectory.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    const int numThreads = juce::jmin (settings.numThreads, files.size());
+
+    // Processors are built here on the message thread; each worker then owns one for the whole batch
+    std::vector<std::unique_ptr<Hw4AudioProcessor>> processors;
+
+    for (int i = 0; i < numThreads; ++i)
+        processors.push_back (createProcessor (settings));
+
+    std::vector<RenderResult> results ((size_t) files.size());
+    std::atomic<int> nextFile { 0 };
+    std::vector<std::unique_ptr<RenderThread>> threads;
+
+   #if HW4_TRACING
+    const auto traceFile = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--trace"));
+
+    if (args.containsOption ("--trace") && ! TraceRecorder::start (traceFile))
+    {
+        std::cerr << "Couldn't write " << traceFile.getFullPathName() << std::endl;
+        return 1;
+    }
+   #endif
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    for (auto& processor : processors)
+    {
+        threads.push_back (std::make_unique<RenderThread> (*processor, files, results, nextFile, settings));
+        threads.back()->startThread();
+    }
+
+    for (auto& thread : threads)
+        thread->waitForThreadToExit (-1);
+
+    const auto wallSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+
+   #if HW4_TRACING
+    TraceRecorder::stop();
+   #endif
+
+    double totalAudioSeconds = 0.0;
+    int numFailed = 0;
+
+    for (int i = 0; i < files.size(); ++i)
+    {
+        const auto& result = results[(size_t) i];
+
+        if (result.error.isNotEmpty())
+        {
+            std::cerr << files[i].getFileName() << ": " << result.error << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        totalAudioSeconds += result.audioSeconds;
+        std::cout << files[i].getFileName() << ": " << juce::String (result.audioSeconds, 2) << " s in "
+                  << juce::String (result.renderSeconds, 2) << " s ("
+                  << juce::String (result.audioSeconds / juce::jmax (1.0e-9, result.renderSeconds), 1) << "x realtime)" << std::endl;
+    }
+
+    std::cout << files.size() - numFailed << " of " << files.size() << " files, " << juce::String (totalAudioSeconds, 1)
+              << " s of audio in " << juce::String (wallSeconds, 2) << " s on " << numThreads << " threads ("
+              << juce::String (totalAudioSeconds / juce::jmax (1.0e-9, wallSeconds), 1) << "x realtime)" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
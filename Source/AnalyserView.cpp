@@ -0,0 +1,258 @@
+/*
+  ==============================================================================
+
+    AnalyserView.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalyserView.h"
+
+namespace
+{
+    constexpr double lowestFrequency = 20.0;
+}
+
+// Constructor Definition
+AnalyserView::AnalyserView(OutputAnalyser& outputAnalyser) : analyser(outputAnalyser) {
+    spectrumDecibels.fill(minimumDecibels);
+    setOpaque(true);
+
+    // The audio thread only starts publishing once someone is listening
+    analyser.setActive(true);
+    startTimerHz(refreshRateHz);
+}
+
+// Destructor Definition
+AnalyserView::~AnalyserView() {
+    stopTimer();
+    analyser.setActive(false);
+}
+
+// Paint
+void AnalyserView::paint(juce::Graphics& g) {
+    if (background.isValid()) {
+        g.drawImageAt(background, 0, 0);
+    } else {
+        g.fillAll(juce::Colours::black);
+    }
+
+    g.setColour(juce::Colours::limegreen);
+    g.strokePath(scopePath, juce::PathStrokeType(1.0f));
+
+    g.setColour(juce::Colours::orange);
+    g.strokePath(spectrumPath, juce::PathStrokeType(1.0f));
+
+    g.setColour(juce::Colours::lightgrey);
+    g.setFont(11.0f);
+    g.drawText("voices " + juce::String(numVoices), scopeArea.reduced(4.0f), juce::Justification::topRight);
+}
+
+// Resized
+void AnalyserView::resized() {
+    auto area = getLocalBounds().toFloat().reduced(2.0f);
+    scopeArea = area.removeFromTop(area.getHeight() * 0.4f);
+    area.removeFromTop(4.0f);
+    spectrumArea = area;
+
+    drawBackground();
+    updateScopePath();
+    updateSpectrumPath();
+}
+
+// Timer Callback
+void AnalyserView::timerCallback() {
+    pullFrames();
+
+    if (analyser.getAnalysisRate() != backgroundRate) {
+        drawBackground();
+        repaint();
+    }
+
+    // Nothing new and nothing left to fall: leave the last picture up and skip the repaint
+    const bool spectrumFalling = std::any_of(spectrumDecibels.begin(), spectrumDecibels.end(),
+                                             [](float level) { return level > minimumDecibels; });
+
+    if (newSamples == 0 && ! spectrumFalling) {
+        return;
+    }
+
+    if (newSamples > 0) {
+        updateScopePath();
+    }
+
+    updateSpectrumLevels();
+    updateSpectrumPath();
+    newSamples = 0;
+    repaint();
+}
+
+// Pull Frames
+void AnalyserView::pullFrames() {
+    OutputAnalyser::Frame frame;
+
+    while (analyser.readFrame(frame)) {
+        for (const float sample : frame.samples) {
+            history[static_cast<size_t>(historyStart)] = sample;
+            historyStart = (historyStart + 1) % fftSize;
+        }
+
+        newSamples += OutputAnalyser::frameSize;
+        numVoices = frame.numVoices;
+    }
+}
+
+// Update Scope Path
+void AnalyserView::updateScopePath() {
+    scopePath.clear();
+
+    if (scopeArea.isEmpty()) {
+        return;
+    }
+
+    auto sampleAt = [this](int index) { return history[static_cast<size_t>((historyStart + index) % fftSize)]; };
+
+    // Start on a rising zero crossing so periodic waves stand still; search one screen back from the newest
+    const int latestStart = fftSize - scopeSize;
+    int start = latestStart;
+
+    for (int i = latestStart; i > latestStart - scopeSize; --i) {
+        if (sampleAt(i - 1) <= 0.0f && sampleAt(i) > 0.0f) {
+            start = i;
+            break;
+        }
+    }
+
+    // Normalised to the window's peak, since the synth's output level is tiny at the usual gains
+    float peak = 0.0f;
+
+    for (int i = 0; i < scopeSize; ++i) {
+        peak = juce::jmax(peak, std::abs(sampleAt(start + i)));
+    }
+
+    const float scale = peak > 0.0f ? 0.45f * scopeArea.getHeight() / peak : 0.0f;
+    const float xStep = scopeArea.getWidth() / static_cast<float>(scopeSize - 1);
+
+    for (int i = 0; i < scopeSize; ++i) {
+        const float x = scopeArea.getX() + xStep * static_cast<float>(i);
+        const float y = scopeArea.getCentreY() - sampleAt(start + i) * scale;
+
+        if (i == 0) {
+            scopePath.startNewSubPath(x, y);
+        } else {
+            scopePath.lineTo(x, y);
+        }
+    }
+}
+
+// Update Spectrum Levels
+void AnalyserView::updateSpectrumLevels() {
+    const double analysisRate = analyser.getAnalysisRate();
+    const double nyquist = 0.5 * analysisRate;
+
+    if (newSamples > 0) {
+        for (int i = 0; i < fftSize; ++i) {
+            fftData[static_cast<size_t>(i)] = history[static_cast<size_t>((historyStart + i) % fftSize)];
+        }
+
+        window.multiplyWithWindowingTable(fftData.data(), static_cast<size_t>(fftSize));
+        fft.performFrequencyOnlyForwardTransform(fftData.data());
+    }
+
+    // A full-scale sine peaks at fftSize / 4 after the Hann window
+    const float magnitudeScale = 4.0f / static_cast<float>(fftSize);
+    const double binsPerHertz = static_cast<double>(fftSize) / analysisRate;
+    int lowBin = 0;
+
+    for (int point = 0; point < numSpectrumPoints; ++point) {
+        // Each point covers the bins between it and the previous one on a log axis, and shows the loudest
+        const double proportion = static_cast<double>(point) / static_cast<double>(numSpectrumPoints - 1);
+        const double frequency = lowestFrequency * std::pow(nyquist / lowestFrequency, proportion);
+        const int highBin = juce::jlimit(lowBin, fftSize / 2, static_cast<int>(frequency * binsPerHertz));
+
+        float level = minimumDecibels;
+
+        if (newSamples > 0) {
+            float magnitude = 0.0f;
+
+            for (int bin = lowBin; bin <= highBin; ++bin) {
+                magnitude = juce::jmax(magnitude, fftData[static_cast<size_t>(bin)]);
+            }
+
+            level = juce::Decibels::gainToDecibels(magnitude * magnitudeScale, minimumDecibels);
+        }
+
+        auto& shown = spectrumDecibels[static_cast<size_t>(point)];
+        shown = juce::jmax(level, shown - spectrumFallPerTick);
+        lowBin = juce::jmin(highBin + 1, fftSize / 2);
+    }
+}
+
+// Update Spectrum Path
+void AnalyserView::updateSpectrumPath() {
+    spectrumPath.clear();
+
+    if (spectrumArea.isEmpty()) {
+        return;
+    }
+
+    const float xStep = spectrumArea.getWidth() / static_cast<float>(numSpectrumPoints - 1);
+
+    for (int point = 0; point < numSpectrumPoints; ++point) {
+        const float x = spectrumArea.getX() + xStep * static_cast<float>(point);
+        const float y = juce::jmap(spectrumDecibels[static_cast<size_t>(point)], minimumDecibels, 0.0f,
+                                   spectrumArea.getBottom(), spectrumArea.getY());
+
+        if (point == 0) {
+            spectrumPath.startNewSubPath(x, y);
+        } else {
+            spectrumPath.lineTo(x, y);
+        }
+    }
+}
+
+// Draw Background
+void AnalyserView::drawBackground() {
+    backgroundRate = analyser.getAnalysisRate();
+
+    if (getWidth() <= 0 || getHeight() <= 0) {
+        background = {};
+        return;
+    }
+
+    background = juce::Image(juce::Image::RGB, getWidth(), getHeight(), true);
+    juce::Graphics g(background);
+    g.fillAll(juce::Colours::black);
+
+    const auto gridColour = juce::Colours::darkgrey.withAlpha(0.6f);
+    g.setColour(gridColour);
+    g.drawRect(scopeArea);
+    g.drawRect(spectrumArea);
+    g.drawHorizontalLine(juce::roundToInt(scopeArea.getCentreY()), scopeArea.getX(), scopeArea.getRight());
+
+    // Level lines every 20 dB
+    g.setFont(10.0f);
+
+    for (float decibels = -20.0f; decibels > minimumDecibels; decibels -= 20.0f) {
+        const float y = juce::jmap(decibels, minimumDecibels, 0.0f, spectrumArea.getBottom(), spectrumArea.getY());
+        g.setColour(gridColour);
+        g.drawHorizontalLine(juce::roundToInt(y), spectrumArea.getX(), spectrumArea.getRight());
+        g.setColour(juce::Colours::grey);
+        g.drawText(juce::String(juce::roundToInt(decibels)), juce::Rectangle<float>(spectrumArea.getX() + 2.0f, y, 30.0f, 12.0f),
+                   juce::Justification::topLeft);
+    }
+
+    // Decade lines on the same log axis as the spectrum points
+    const double nyquist = 0.5 * backgroundRate;
+
+    for (double frequency = 100.0; frequency < nyquist; frequency *= 10.0) {
+        const double proportion = std::log(frequency / lowestFrequency) / std::log(nyquist / lowestFrequency);
+        const float x = spectrumArea.getX() + static_cast<float>(proportion) * spectrumArea.getWidth();
+        g.setColour(gridColour);
+        g.drawVerticalLine(juce::roundToInt(x), spectrumArea.getY(), spectrumArea.getBottom());
+        g.setColour(juce::Colours::grey);
+        g.drawText(frequency >= 1000.0 ? juce::String(juce::roundToInt(frequency / 1000.0)) + "k" : juce::String(juce::roundToInt(frequency)),
+                   juce::Rectangle<float>(x + 2.0f, spectrumArea.getBottom() - 12.0f, 30.0f, 12.0f),
+                   juce::Justification::bottomLeft);
+    }
+}
@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    AnalyserView.h
+
+    Oscilloscope and spectrum of the synth's output, fed by OutputAnalyser.
+    All the work happens on the message thread in a timer: drain the frames
+    the audio thread published, run one FFT, and rebuild two cached paths.
+    It only repaints when new audio arrived or the spectrum is still falling,
+    and the grid is drawn once per resize into an image.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "OutputAnalyser.h"
+
+class AnalyserView : public juce::Component,
+                     private juce::Timer
+{
+public:
+    explicit AnalyserView(OutputAnalyser& outputAnalyser);
+    ~AnalyserView() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int scopeSize = 512;
+    static constexpr int numSpectrumPoints = 256;
+    static constexpr float minimumDecibels = -100.0f;
+    static constexpr float spectrumFallPerTick = 3.0f;   // dB; peaks decay instead of flickering
+    static constexpr int refreshRateHz = 30;
+
+    OutputAnalyser& analyser;
+
+    juce::dsp::FFT fft { fftOrder };
+    juce::dsp::WindowingFunction<float> window { static_cast<size_t>(fftSize), juce::dsp::WindowingFunction<float>::hann, false };
+
+    // Most recent decimated output, oldest first from historyStart
+    std::array<float, fftSize> history {};
+    int historyStart = 0;
+    int newSamples = 0;
+    int numVoices = 0;
+
+    std::array<float, 2 * fftSize> fftData {};
+    std::array<float, numSpectrumPoints> spectrumDecibels;
+
+    juce::Rectangle<float> scopeArea, spectrumArea;
+    juce::Image background;
+    double backgroundRate = 0.0;   // The analysis rate the frequency grid was drawn for
+    juce::Path scopePath, spectrumPath;
+
+    void timerCallback() override;
+    void pullFrames();
+    void updateScopePath();
+    void updateSpectrumLevels();
+    void updateSpectrumPath();
+    void drawBackground();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalyserView)
+};
@@ -0,0 +1,225 @@
+/*
+  ==============================================================================
+
+    Envelope.cpp
+
+  ==============================================================================
+*/
+
+#include "Envelope.h"
+
+// Calculate Coefficients
+EnvelopeCoefficients EnvelopeCoefficients::calculate(const EnvelopeParameters& parameters, double sampleRate) {
+    auto toSamples = [sampleRate] (double milliseconds) {
+        return std::max(1.0, std::round(milliseconds * 0.001 * sampleRate));
+    };
+
+    EnvelopeCoefficients coefficients;
+
+    coefficients.attackSamples = static_cast<int>(toSamples(parameters.attackMilliseconds));
+    coefficients.decaySamples = static_cast<int>(toSamples(parameters.decayMilliseconds));
+    coefficients.sustainLevel = juce::jlimit(0.0, 1.0, parameters.sustainLevel);
+    coefficients.cullRatio = juce::Decibels::decibelsToGain(parameters.cullDecibels, -200.0);
+
+    // Per-sample multipliers that cover 60 dB over the given time
+    coefficients.decayMultiplier = std::pow(0.001, 1.0 / coefficients.decaySamples);
+    coefficients.releaseMultiplier = std::pow(0.001, 1.0 / toSamples(parameters.releaseMilliseconds));
+    coefficients.fadeOutMultiplier = std::pow(0.001, 1.0 / toSamples(parameters.fadeOutMilliseconds));
+
+    return coefficients;
+}
+
+//==============================================================================
+// Start
+void Envelope::start(double newPeak, const EnvelopeCoefficients& newCoefficients) {
+    gain = 0.0;
+    retrigger(newPeak, newCoefficients);
+}
+
+// Retrigger
+void Envelope::retrigger(double newPeak, const EnvelopeCoefficients& newCoefficients) {
+    peak = newPeak;
+    coefficients = newCoefficients;
+    fadingOut = false;
+    enterStage(Attack);
+}
+
+// Release
+void Envelope::release() {
+    if (stage < Release) {
+        enterStage(Release);
+    }
+}
+
+// Fade Out
+void Envelope::fadeOut() {
+    if (stage == Finished || fadingOut) {
+        return;
+    }
+
+    // Restarting the release from the current gain keeps the curve continuous
+    fadingOut = true;
+    coefficients.releaseMultiplier = std::min(coefficients.releaseMultiplier, coefficients.fadeOutMultiplier);
+    enterStage(Release);
+}
+
+// Rescale
+void Envelope::rescale(double sampleRateRatio) {
+    auto stretch = [sampleRateRatio] (int numSamples) {
+        return std::max(1, juce::roundToInt(numSamples * sampleRateRatio));
+    };
+
+    // A multiplier applied once per sample covers the same fall over the stretched sample count
+    auto stretchMultiplier = [sampleRateRatio] (double perSample) {
+        return std::pow(perSample, 1.0 / sampleRateRatio);
+    };
+
+    coefficients.attackSamples = stretch(coefficients.attackSamples);
+    coefficients.decaySamples = stretch(coefficients.decaySamples);
+    coefficients.decayMultiplier = stretchMultiplier(coefficients.decayMultiplier);
+    coefficients.releaseMultiplier = stretchMultiplier(coefficients.releaseMultiplier);
+    coefficients.fadeOutMultiplier = stretchMultiplier(coefficients.fadeOutMultiplier);
+
+    switch (stage) {
+        case Attack:
+            samplesLeft = stretch(samplesLeft);
+            offset = (peak - gain) / samplesLeft;
+            break;
+
+        case Decay: {
+            // Same target, approached at the new rate
+            const double target = offset / (1.0 - multiplier);
+            multiplier = coefficients.decayMultiplier;
+            offset = (1.0 - multiplier) * target;
+            samplesLeft = stretch(samplesLeft);
+            break;
+        }
+
+        case Release:
+            // Restarts from the current gain, which also works out the new distance to the cull floor
+            enterStage(Release);
+            break;
+
+        case Sustain:
+        case Finished:
+        default:
+            break;
+    }
+}
+
+// Advance
+void Envelope::advance(int numSamples, double newGain) {
+    jassert(numSamples <= samplesLeft);
+
+    gain = newGain;
+
+    if (samplesLeft == unbounded) {
+        return;
+    }
+
+    samplesLeft -= numSamples;
+
+    if (samplesLeft <= 0) {
+        enterStage(stage == Release ? Finished : static_cast<Stage>(stage + 1));
+    }
+}
+
+// Skip
+int Envelope::skip(int numSamples) {
+    int skipped = 0;
+
+    while (skipped < numSamples && stage != Finished) {
+        const int segmentSamples = std::min(numSamples - skipped, samplesLeft);
+        double newGain = gain + offset * segmentSamples;
+
+        // n steps of gain * multiplier + offset is a geometric series
+        if (multiplier != 1.0) {
+            const double power = std::pow(multiplier, segmentSamples);
+            newGain = power * gain + offset * (1.0 - power) / (1.0 - multiplier);
+        }
+
+        advance(segmentSamples, newGain);
+        skipped += segmentSamples;
+    }
+
+    return skipped;
+}
+
+// Enter Stage
+void Envelope::enterStage(Stage newStage) {
+    stage = newStage;
+
+    switch (stage) {
+        case Attack:
+            // Straight line to the peak
+            multiplier = 1.0;
+            offset = (peak - gain) / coefficients.attackSamples;
+            samplesLeft = coefficients.attackSamples;
+            break;
+
+        case Decay: {
+            gain = peak;
+            const double sustain = peak * coefficients.sustainLevel;
+
+            if (sustain >= peak) {
+                enterStage(Sustain);
+                return;
+            }
+
+            // Exponential approach: the distance to a target shrinks by the multiplier every sample.
+            // The target sits just below the sustain level, so the last sample of the decay lands on
+            // it exactly and the sustain starts where the decay left off.
+            multiplier = coefficients.decayMultiplier;
+            const double remaining = std::pow(multiplier, coefficients.decaySamples);
+            const double target = (sustain - peak * remaining) / (1.0 - remaining);
+            offset = (1.0 - multiplier) * target;
+            samplesLeft = coefficients.decaySamples;
+
+            // A sustain under the cull floor would hold an inaudible tone for as long as the key is down,
+            // so the tone finishes where the decay crosses the floor instead
+            const double floor = peak * coefficients.cullRatio;
+
+            if (sustain <= floor) {
+                const double crossing = std::log((floor - target) / (peak - target)) / std::log(multiplier);
+                samplesLeft = juce::jlimit(1, coefficients.decaySamples, static_cast<int>(std::ceil(crossing)));
+            }
+
+            break;
+        }
+
+        case Sustain:
+            if (coefficients.sustainLevel <= coefficients.cullRatio) {
+                enterStage(Finished);
+                return;
+            }
+
+            gain = peak * coefficients.sustainLevel;
+            multiplier = 1.0;
+            offset = 0.0;
+            samplesLeft = unbounded;
+            break;
+
+        case Release: {
+            // The release is a pure exponential, so the sample it crosses the cull floor is known up front
+            const double floor = peak * coefficients.cullRatio;
+            multiplier = coefficients.releaseMultiplier;
+            offset = 0.0;
+
+            if (gain <= floor) {
+                enterStage(Finished);
+                return;
+            }
+
+            samplesLeft = std::max(1, static_cast<int>(std::ceil(std::log(floor / gain) / std::log(multiplier))));
+            break;
+        }
+
+        case Finished:
+        default:
+            gain = 0.0;
+            multiplier = 0.0;
+            offset = 0.0;
+            samplesLeft = unbounded;
+            break;
+    }
+}
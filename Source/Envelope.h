@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    Envelope.h
+
+    ADSR envelope built from affine segments. Inside a segment the gain
+    follows gain = gain * multiplier + offset every sample: a linear attack,
+    exponential decay towards the sustain level, a flat sustain and an
+    exponential release. Every segment's length in samples is known when it
+    starts, so renderers can run whole segments in tight, vectorisable loops
+    and only stop at the boundaries.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+// User-facing settings; times are in milliseconds so they sound the same at any sample rate
+struct EnvelopeParameters
+{
+    double attackMilliseconds = 3.2;    // Linear rise from the current gain to the peak
+    double decayMilliseconds = 100.0;   // Exponential fall that reaches the sustain level in this time
+    double sustainLevel = 1.0;          // Fraction of the peak held while the key is down; tones finish
+                                        // at the end of the decay if it is under the cull floor
+    double releaseMilliseconds = 3.0;   // Falls 60 dB
+    double cullDecibels = -80.0;        // Released tones finish this far below their peak
+    double fadeOutMilliseconds = 5.0;   // Falls 60 dB when a voice is shed rather than released
+
+    bool operator==(const EnvelopeParameters& other) const {
+        return attackMilliseconds == other.attackMilliseconds && decayMilliseconds == other.decayMilliseconds
+            && sustainLevel == other.sustainLevel && releaseMilliseconds == other.releaseMilliseconds
+            && cullDecibels == other.cullDecibels && fadeOutMilliseconds == other.fadeOutMilliseconds;
+    }
+
+    bool operator!=(const EnvelopeParameters& other) const { return !(*this == other); }
+};
+
+// EnvelopeParameters converted to per-sample values for one sample rate
+struct EnvelopeCoefficients
+{
+    int attackSamples = 1;
+    int decaySamples = 1;
+    double decayMultiplier = 0.0;
+    double sustainLevel = 1.0;
+    double releaseMultiplier = 0.0;
+    double fadeOutMultiplier = 0.0;
+    double cullRatio = 1.0e-4;
+
+    static EnvelopeCoefficients calculate(const EnvelopeParameters& parameters, double sampleRate);
+};
+
+class Envelope
+{
+public:
+    enum Stage {Attack, Decay, Sustain, Release, Finished};
+
+    // Length reported by segments that only end on an event
+    static constexpr int unbounded = std::numeric_limits<int>::max();
+
+    // Starts from silence, or from the current gain when retriggering a sounding tone
+    void start(double newPeak, const EnvelopeCoefficients& newCoefficients);
+    void retrigger(double newPeak, const EnvelopeCoefficients& newCoefficients);
+    void release();
+    // Releases with the fade-out time if that is quicker, so a shed voice goes quiet without a click
+    void fadeOut();
+    // Stretches the envelope for a new sample rate, given as new rate / old rate, so a sounding
+    // tone keeps its place in the current segment and its times in milliseconds
+    void rescale(double sampleRateRatio);
+
+    // Moves numSamples through the current segment, which must not be more than are left in it,
+    // taking the gain the caller reached; enters the next segment at the boundary
+    void advance(int numSamples, double newGain);
+    // Moves numSamples on without rendering, working out each segment's gain in closed form;
+    // returns how many of them passed before the envelope finished
+    int skip(int numSamples);
+
+    double getGain() const { return gain; }
+    double getPeak() const { return peak; }
+    double getMultiplier() const { return multiplier; }
+    double getOffset() const { return offset; }
+    int getSamplesUntilNextStage() const { return samplesLeft; }
+
+    Stage getStage() const { return stage; }
+    bool isReleased() const { return stage >= Release; }
+    bool isFadingOut() const { return fadingOut; }
+    bool isFinished() const { return stage == Finished; }
+
+private:
+    EnvelopeCoefficients coefficients;
+    Stage stage = Finished;
+    double gain = 0.0, peak = 0.0;
+    double multiplier = 0.0, offset = 0.0;
+    int samplesLeft = unbounded;
+    bool fadingOut = false;
+
+    void enterStage(Stage newStage);
+};
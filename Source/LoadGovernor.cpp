@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    LoadGovernor.cpp
+
+  ==============================================================================
+*/
+
+#include "LoadGovernor.h"
+
+// Set Settings
+void LoadGovernor::setSettings(const Settings& newSettings) {
+    settings = newSettings;
+    prepare(sampleRate);
+}
+
+// Prepare
+void LoadGovernor::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+    averageLoad = 0.0f;
+    setLevel(fullQuality);
+}
+
+// Set Enabled
+void LoadGovernor::setEnabled(bool shouldBeEnabled) {
+    if (shouldBeEnabled == enabled) {
+        return;
+    }
+
+    enabled = shouldBeEnabled;
+    averageLoad = 0.0f;
+    setLevel(fullQuality);
+}
+
+// Update
+void LoadGovernor::update(int numSamples, float load) {
+    if (!enabled || numSamples <= 0) {
+        return;
+    }
+
+    // One-pole average weighted by block length, so any block size reacts over the same time
+    const double blockSeconds = numSamples / sampleRate;
+    averageLoad += (load - averageLoad) * static_cast<float>(std::min(1.0, blockSeconds / settings.averagingSeconds));
+    secondsSinceChange += blockSeconds;
+
+    const int currentLevel = level.load(std::memory_order_relaxed);
+
+    // The render path can change under a level, when the oscillator mode or precision does
+    usingEconomyOscillators.store(toneBank.isUsingEconomyOscillators() && toneBank.canUseEconomyOscillators(), std::memory_order_relaxed);
+
+    if (averageLoad > settings.shedThreshold) {
+        secondsBelowRestore = 0.0;
+
+        if (currentLevel < numLevels - 1 && secondsSinceChange >= settings.shedHoldSeconds) {
+            setLevel(stepLevel(currentLevel, 1));
+        }
+    } else if (averageLoad < settings.restoreThreshold && currentLevel > fullQuality) {
+        secondsBelowRestore += blockSeconds;
+
+        if (secondsBelowRestore >= settings.restoreHoldSeconds) {
+            setLevel(stepLevel(currentLevel, -1));
+        }
+    } else {
+        secondsBelowRestore = 0.0;
+    }
+}
+
+// Set Level
+void LoadGovernor::setLevel(int newLevel) {
+    level.store(newLevel, std::memory_order_relaxed);
+    secondsSinceChange = 0.0;
+    secondsBelowRestore = 0.0;
+
+    const auto polyphony = static_cast<float>(toneBank.getPolyphony());
+    int voiceLimit = ToneBank::maxPolyphony;
+
+    if (newLevel >= fewestVoices) {
+        voiceLimit = juce::roundToInt(polyphony * settings.fewestVoicesFraction);
+    } else if (newLevel >= fewerVoices) {
+        voiceLimit = juce::roundToInt(polyphony * settings.fewerVoicesFraction);
+    }
+
+    toneBank.setVoiceLimit(voiceLimit);
+    toneBank.setEconomyOscillators(newLevel >= economyOscillators);
+    usingEconomyOscillators.store(toneBank.isUsingEconomyOscillators() && toneBank.canUseEconomyOscillators(), std::memory_order_relaxed);
+}
+
+// Step Level
+int LoadGovernor::stepLevel(int fromLevel, int step) const {
+    const int newLevel = juce::jlimit(static_cast<int>(fullQuality), numLevels - 1, fromLevel + step);
+
+    // A step that would only swap oscillators the lanes don't use would shed nothing
+    if (newLevel == economyOscillators && !toneBank.canUseEconomyOscillators()) {
+        return fromLevel + 2 * step;
+    }
+
+    return newLevel;
+}
+
+// Describe
+juce::String LoadGovernor::describe(Level level, bool economyOscillatorsInUse) {
+    const juce::String oscillators = economyOscillatorsInUse ? ", economy oscillators" : "";
+
+    switch (level) {
+        case fewerVoices:
+        case economyOscillators: return "fewer voices" + oscillators;
+        case fewestVoices:       return "fewest voices" + oscillators;
+        case fullQuality:
+        case numLevels:
+        default:                 return "full quality";
+    }
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    LoadGovernor.h
+
+    Sheds synthesis work before processBlock starts missing its deadline.
+    The audio thread hands it every block's load (time spent / time
+    available); it keeps a short moving average and, while that sits above
+    the shed threshold, steps quality down one level at a time. Once the
+    average has stayed below the restore threshold for a while it steps
+    back up. Levels are applied to the ToneBank on the audio thread and
+    published for the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "MIDISynth.h"
+
+class LoadGovernor
+{
+public:
+    // Cumulative: each level keeps the steps of the ones before it. The economy oscillator
+    // level is passed over while the ToneBank renders on SIMD lanes, where it saves nothing.
+    enum Level {fullQuality, fewerVoices, economyOscillators, fewestVoices, numLevels};
+
+    struct Settings
+    {
+        float shedThreshold = 0.75f;        // Average load that sheds the next step
+        float restoreThreshold = 0.4f;      // Average load that, held long enough, brings one back
+        double averagingSeconds = 0.1;
+        double shedHoldSeconds = 0.1;       // Between steps down, so the average sees each one land
+        double restoreHoldSeconds = 2.0;    // Quiet time before each step up
+        float fewerVoicesFraction = 0.75f;  // Voice caps, as fractions of the polyphony
+        float fewestVoicesFraction = 0.5f;
+    };
+
+    explicit LoadGovernor(ToneBank& toneBankToGovern) : toneBank(toneBankToGovern) {}
+
+    // Both reset to full quality; call while the audio thread isn't running
+    void setSettings(const Settings& newSettings);
+    void prepare(double newSampleRate);
+
+    // Audio thread. Disabling puts full quality back at once.
+    void setEnabled(bool shouldBeEnabled);
+    void update(int numSamples, float load);
+
+    // Any thread
+    Level getLevel() const { return static_cast<Level>(level.load(std::memory_order_relaxed)); }
+    bool isUsingEconomyOscillators() const { return usingEconomyOscillators.load(std::memory_order_relaxed); }
+    static juce::String describe(Level level, bool economyOscillatorsInUse);
+
+private:
+    ToneBank& toneBank;
+    Settings settings;
+    double sampleRate = 44100.0;
+    std::atomic<int> level { fullQuality };
+    std::atomic<bool> usingEconomyOscillators { false };
+
+    // Audio thread only
+    bool enabled = true;
+    float averageLoad = 0.0f;
+    double secondsSinceChange = 0.0, secondsBelowRestore = 0.0;
+
+    void setLevel(int newLevel);
+    int stepLevel(int fromLevel, int step) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadGovernor)
+};
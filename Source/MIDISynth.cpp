@@ -9,142 +9,422 @@
 */
 
 #include "MIDISynth.h"
+#include "TraceRecorder.h"
 
-Tone::Tone(float frequency, float velocity, WaveType waveType, double sampleRate, double attackFactor, double decayFactor)
-    :waveType(waveType),
-    frequency(static_cast<double>(frequency)),
-    isReleased(false),
-    gain(.1),
-    velocity(static_cast<double>(velocity)),
-    counter(0),
-    sampleRate(sampleRate),
-    attackFactor(attackFactor),
-    decayFactor(decayFactor)
+// Instant trace event with the channel and note a tone was started for
+#define HW4_TRACE_TONE(type, tone) \
+    HW4_TRACE_EVENT(type, noteForTone[static_cast<size_t>(tones.getIndex(tone))] / numMidiNotes + 1, \
+                    noteForTone[static_cast<size_t>(tones.getIndex(tone))] % numMidiNotes)
+
+namespace
+{
+    using Phase = PhaseAccumulator::Phase;
+
+    // Renders one envelope segment of one tone, adding it to outLeft scaled by panLeft, or panned to both outputs.
+    // A tone's wave type, oscillator mode and output layout never change inside a block, so they
+    // are template parameters and the inner loop has no branches left to take. The sample type
+    // is one too, so the float path never round-trips through double and the double path never
+    // drops to float.
+    template <typename SampleType>
+    using ToneKernel = void (*)(Phase& phase, Phase phaseIncrement, SampleType& gain, SampleType multiplier, SampleType offset,
+                                const Wavetable& wavetable, SampleType panLeft, SampleType panRight,
+                                SampleType* outLeft, SampleType* outRight, int numSamples);
+
+    // Normalised phase in [0, 1) at the working precision
+    template <typename SampleType>
+    inline SampleType normalisedPhase(Phase phase) {
+        if constexpr (std::is_same_v<SampleType, float>) {
+            return PhaseAccumulator::toFloat(phase);
+        } else {
+            return static_cast<SampleType>(PhaseAccumulator::toDouble(phase));
+        }
+    }
+
+    template <typename SampleType, Tone::WaveType waveType, Tone::OscillatorMode oscillatorMode>
+    inline SampleType toneSample(const Wavetable& wavetable, Phase phase) {
+        // Table lookup replaces evaluating the waveform
+        if constexpr (oscillatorMode == Tone::WavetableLinear) {
+            return static_cast<SampleType>(wavetable.processLinear(phase));
+        } else if constexpr (oscillatorMode == Tone::WavetableCubic) {
+            return static_cast<SampleType>(wavetable.processCubic(phase));
+        } else if constexpr (waveType == Tone::Sine) {
+            return std::sin(juce::MathConstants<SampleType>::twoPi * normalisedPhase<SampleType>(phase));
+        } else if constexpr (waveType == Tone::Square) {
+            return phase < PhaseAccumulator::halfCycle ? SampleType(1) : SampleType(-1);
+        } else {
+            return SampleType(2) * normalisedPhase<SampleType>(phase) - SampleType(1);
+        }
+    }
+
+    template <typename SampleType, Tone::WaveType waveType, Tone::OscillatorMode oscillatorMode, bool stereo>
+    void renderToneSegment(Phase& phase, Phase phaseIncrement, SampleType& gain, SampleType multiplier, SampleType offset,
+                           const Wavetable& wavetable, SampleType panLeft, SampleType panRight,
+                           SampleType* outLeft, SampleType* outRight, int numSamples) {
+        // Work on local copies so the loop state stays in registers
+        Phase currentPhase = phase;
+        SampleType currentGain = gain;
+
+        for (int i = 0; i < numSamples; ++i) {
+            // Update the gain based on the envelope
+            currentGain = currentGain * multiplier + offset;
+
+            // Add the current wave sample to the output
+            const SampleType sample = toneSample<SampleType, waveType, oscillatorMode>(wavetable, currentPhase) * currentGain;
+
+            if constexpr (stereo) {
+                outLeft[i] += sample * panLeft;
+                outRight[i] += sample * panRight;
+            } else {
+                outLeft[i] += sample * panLeft;
+            }
+
+            // Advance the phase; unsigned overflow is the wrap
+            currentPhase += phaseIncrement;
+        }
+
+        phase = currentPhase;
+        gain = currentGain;
+    }
+
+    // Every (oscillator mode, output layout, wave type), generated from the enums so new waves only need a toneSample() case
+    template <typename SampleType>
+    using ToneKernelsForWaves = std::array<ToneKernel<SampleType>, Tone::numWaveTypes>;
+
+    template <typename SampleType, int oscillatorMode, bool stereo, int... waveTypes>
+    constexpr ToneKernelsForWaves<SampleType> makeToneKernels(std::integer_sequence<int, waveTypes...>) {
+        return { renderToneSegment<SampleType, static_cast<Tone::WaveType>(waveTypes), static_cast<Tone::OscillatorMode>(oscillatorMode), stereo>... };
+    }
+
+    // Mono, then stereo
+    template <typename SampleType, int oscillatorMode>
+    constexpr std::array<ToneKernelsForWaves<SampleType>, 2> makeToneKernelsForLayouts() {
+        constexpr auto waveTypes = std::make_integer_sequence<int, Tone::numWaveTypes>();
+        return { makeToneKernels<SampleType, oscillatorMode, false>(waveTypes), makeToneKernels<SampleType, oscillatorMode, true>(waveTypes) };
+    }
+
+    template <typename SampleType, int... oscillatorModes>
+    constexpr auto makeToneKernelTable(std::integer_sequence<int, oscillatorModes...>) {
+        return std::array<std::array<ToneKernelsForWaves<SampleType>, 2>, Tone::numOscillatorModes> {
+            makeToneKernelsForLayouts<SampleType, oscillatorModes>()...
+        };
+    }
+
+    template <typename SampleType>
+    constexpr auto toneKernels = makeToneKernelTable<SampleType>(std::make_integer_sequence<int, Tone::numOscillatorModes>());
+
+    static_assert(Tone::numWaveTypes == SIMDToneEngine::numWaveTypes, "Tones and SIMD lanes must agree on the wave types");
+}
+
+Tone::Tone()
+    :waveType(Sine),
+    frequency(0.0),
+    phase(0),
+    phaseIncrement(0),
+    sampleRate(44100.0)
 {
-    velocity = std::clamp(velocity, 0.0f, 127.0f) / 127.0f;
 }
 Tone::~Tone(){
     
 }
 
+void Tone::start(float newFrequency, float newVelocity, WaveType newWaveType, double newSampleRate, const EnvelopeCoefficients& envelopeCoefficients) {
+    waveType = newWaveType;
+    frequency = static_cast<double>(newFrequency);
+    phase = 0;
+    sampleRate = newSampleRate;
+    updatePhaseIncrement();
+
+    // The envelope peaks at the velocity, normalised to 0-1
+    envelope.start(static_cast<double>(std::clamp(newVelocity, 0.0f, 1.0f)), envelopeCoefficients);
+}
+
+void Tone::retrigger(float newVelocity, const EnvelopeCoefficients& envelopeCoefficients) {
+    envelope.retrigger(static_cast<double>(std::clamp(newVelocity, 0.0f, 1.0f)), envelopeCoefficients);
+}
+
 void Tone::setSampleRate(double newSampleRate) {
+    if (newSampleRate != sampleRate) {
+        envelope.rescale(newSampleRate / sampleRate);
+    }
+
     sampleRate = newSampleRate;
+    updatePhaseIncrement();
 }
 
 void Tone::setWaveType(WaveType newWaveType) {
     waveType = newWaveType;
 }
 
+void Tone::setOscillatorMode(OscillatorMode newOscillatorMode) {
+    oscillatorMode = newOscillatorMode;
+}
+
 void Tone::setFrequency(double newFrequency) {
     frequency = newFrequency;
+    updatePhaseIncrement();
 }
 
-void Tone::setGain(double newGain) {
-    gain = newGain;
+void Tone::setReleased() {
+    envelope.release();
 }
 
-void Tone::setReleased() {
-    isReleased = true;
+void Tone::fadeOut() {
+    envelope.fadeOut();
 }
 
-void Tone::updateTone() {
+void Tone::setPan(float newPan) {
+    pan = juce::jlimit(-1.0f, 1.0f, newPan);
+    updateOutputGains();
+}
 
-    if (!isReleased) {
-        // Attack Phase: Increase gain towards velocity
-        gain *= attackFactor;
+void Tone::setGain(float newGain) {
+    gain = std::max(0.0f, newGain);
+    updateOutputGains();
+}
 
-        // Clamp gain to not exceed the normalized velocity
-        if (gain >= velocity) {
-            gain = velocity;
-        }
-    } else {
-        // Release Phase: Decrease gain
-        gain *= decayFactor;
+void Tone::updateOutputGains() {
+    // Constant-power law, scaled by sqrt(2) so a centred tone keeps unity gain on both sides
+    // and sounds the same whether the mix is mono or stereo
+    const float angle = (pan + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+    panLeft = gain * juce::MathConstants<float>::sqrt2 * std::cos(angle);
+    panRight = gain * juce::MathConstants<float>::sqrt2 * std::sin(angle);
 
+    if (pan == 0.0f) {
+        panLeft = panRight = gain;
     }
 }
 
-void Tone::updateCounter() {
-    // Increment the counter based on frequency and sample rate
-    double phaseIncrement = frequency / sampleRate;
-    counter += static_cast<long long>(phaseIncrement * 1000000); // Scaling factor for precision
+void Tone::updatePhaseIncrement() {
+    // Only recomputed when the frequency or sample rate changes, never per sample
+    phaseIncrement = PhaseAccumulator::incrementFor(frequency, sampleRate);
+}
+
+// Lane State
+ToneLaneState Tone::getLaneState(bool stereo) const {
+    ToneLaneState state;
+    state.phase = phase;
+    state.phaseIncrement = phaseIncrement;
+    state.gain = static_cast<float>(envelope.getGain());
+    state.envelopeMultiplier = static_cast<float>(envelope.getMultiplier());
+    state.envelopeOffset = static_cast<float>(envelope.getOffset());
+    // A mono mix ignores the pan but keeps the gain
+    state.panLeft = stereo ? panLeft : gain;
+    state.panRight = panRight;
+    return state;
+}
+
+void Tone::setLaneState(const ToneLaneState& state, int numSamplesRendered) {
+    phase = state.phase;
+    envelope.advance(numSamplesRendered, static_cast<double>(state.gain));
+}
+
+// Process Sample
+void Tone::processSample(float& sample) {
+    renderBlock<float>(&sample, nullptr, 1);
+}
+
+// Skip
+void Tone::skip(int numSamples) {
+    // Rendering stops moving the phase once the envelope finishes, so skipping does too
+    const int skipped = envelope.skip(numSamples);
+    phase += phaseIncrement * static_cast<PhaseAccumulator::Phase>(skipped);
+}
+
+// Render Block
+template <typename SampleType>
+void Tone::renderBlock(SampleType* outLeft, SampleType* outRight, int numSamples) {
+    // Dispatch once per block; the kernel runs every segment without looking at the wave type again
+    const auto kernel = toneKernels<SampleType>[static_cast<size_t>(oscillatorMode)][outRight != nullptr ? 1 : 0][static_cast<size_t>(waveType)];
+    const auto& wavetable = Wavetable::forWaveType(waveType);
 
-    // Wrap the counter to prevent overflow
-    if (counter > 1000000) {
-        counter -= 1000000;
+    // One tight loop per envelope segment; the segment lengths are known in advance
+    while (numSamples > 0 && !envelope.isFinished()) {
+        const int segmentSamples = std::min(numSamples, envelope.getSamplesUntilNextStage());
+        auto currentGain = static_cast<SampleType>(envelope.getGain());
+
+        kernel(phase, phaseIncrement, currentGain,
+               static_cast<SampleType>(envelope.getMultiplier()), static_cast<SampleType>(envelope.getOffset()), wavetable,
+               static_cast<SampleType>(outRight != nullptr ? panLeft : gain), static_cast<SampleType>(panRight),
+               outLeft, outRight, segmentSamples);
+
+        envelope.advance(segmentSamples, static_cast<double>(currentGain));
+        outLeft += segmentSamples;
+        outRight += (outRight != nullptr) ? segmentSamples : 0;
+        numSamples -= segmentSamples;
     }
 }
 
-float Tone::generateWaveSample() {
-    float sample = 0.0f;
+template void Tone::renderBlock<float>(float*, float*, int);
+template void Tone::renderBlock<double>(double*, double*, int);
 
-    // Calculate the phase as a value between 0 and 1
-    double phase = static_cast<double>(counter) / 1000000.0; // Example normalization based on counter scaling
+// Should Be Removed
+bool Tone::shouldBeRemoved() const {
+    // The release ends at the cull floor rather than waiting for the gain to underflow
+    return envelope.isFinished();
+}
 
-    switch (waveType) {
-        case Sine:
-            sample = static_cast<float>(std::sin(2.0 * M_PI * phase)) * static_cast<float>(gain);
-            break;
-        case Square:
-            sample = (phase < 0.5) ? static_cast<float>(gain) : static_cast<float>(-gain);
-            break;
-        case Sawtooth:
-            sample = static_cast<float>((2.0 * phase) - 1.0) * static_cast<float>(gain);
-            break;
-        default:
-            sample = 0.0f;
-            break;
+// Prepare Pool
+void TonePool::prepare(int newCapacity) {
+    jassert(newCapacity > 0);
+
+    tones.assign(static_cast<size_t>(newCapacity), Tone());
+    freeList.resize(static_cast<size_t>(newCapacity));
+    activeList.prepare(1, newCapacity);
+
+    reset();
+}
+
+// Reset Pool
+void TonePool::reset() {
+    numFree = getCapacity();
+    numActive = 0;
+    activeList.clear();
+
+    // Hand out low indices first
+    for (int i = 0; i < numFree; ++i) {
+        freeList[static_cast<size_t>(i)] = numFree - 1 - i;
     }
+}
 
-    // Update the counter after generating the sample
-    updateCounter();
+// Acquire Tone
+Tone* TonePool::acquire() {
+    if (numFree == 0) {
+        return nullptr;
+    }
 
-    return sample;
+    // Append to the newest end of the active list
+    const int index = freeList[static_cast<size_t>(--numFree)];
+    activeList.append(0, index);
+    ++numActive;
+
+    return tonesAt(index);
 }
 
-// Process Sample
-void Tone::processSample(float& sample) {
-    
-    // Update the gain based on the envelope
-    updateTone();
-    
-    // Generate the current wave sample and update the counter
-    float waveSample = generateWaveSample();
+// Release Tone
+void TonePool::release(Tone* tone) {
+    jassert(tone != nullptr && numActive > 0);
 
-    // Add the wave sample to the provided sample
-    sample += waveSample;
+    const int index = indexOf(tone);
+    activeList.remove(index);
 
-//    // Update the gain based on the envelope
-//    updateTone();
+    freeList[static_cast<size_t>(numFree++)] = index;
+    --numActive;
 }
 
-// Should Be Removed
-bool Tone::shouldBeRemoved() const {
-    return isReleased && (gain <= 0.0);
+// Move Tone to the Newest End
+void TonePool::moveToNewest(Tone* tone) {
+    const int index = indexOf(tone);
+
+    activeList.remove(index);
+    activeList.append(0, index);
 }
 
 // Constructor Definition
 ToneBank::ToneBank()
     : wavetype(Tone::Sine),    // Default wave type
+      oscillatorMode(Tone::Direct),
+      toneOscillatorMode(Tone::Direct),
       sampleRate(44100.0),     // Default sample rate
-      ATTACK_FACTOR(1.05),     // Example value; adjust as needed
-      DECAY_FACTOR(0.95),       // Example value; adjust as needed
-      masterGain(.0001f)
+      masterGain(defaultMasterGain)
 {
+    prepareVoices();
+    prepareMixBuffer();
+    updateEnvelopeCoefficients();
 }
 
 // Destructor Definition
 ToneBank::~ToneBank() {
-    // Unique pointers automatically clean up Tone instances
+    // The pool owns its tones and frees them with its storage
 }
 
 // Prepare to Play
-void ToneBank::prepareToPlay(double newSampleRate) {
+void ToneBank::prepareToPlay(double newSampleRate, int newMaximumBlockSize) {
     sampleRate = newSampleRate;
+    updateEnvelopeCoefficients();
 
-    // Update sample rate for all active tones
-    for (auto& tonePtr : tones) {
-        tonePtr->setSampleRate(sampleRate);
+    // Ramp gain changes instead of stepping them
+    masterGain.reset(sampleRate, masterGainRampSeconds);
+
+    // Allocate the voice storage up front so the audio thread never has to
+    if (tones.getCapacity() != polyphony + stealingHeadroom) {
+        prepareVoices();
+    }
+
+    // Scratch holds one render pass: the quantum, or less when the host's blocks are smaller.
+    // Larger blocks, announced or not, are rendered in several passes rather than reallocating.
+    const int newPassSize = juce::jlimit(1, renderQuantum, newMaximumBlockSize);
+
+    if (newPassSize != passSize) {
+        passSize = newPassSize;
+        prepareMixBuffer();
+        prepareParallelRendering();
+    }
+
+    // Update sample rate for all active tones; their envelopes are stretched to match
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        tone->setSampleRate(sampleRate);
+    }
+}
+
+// Prepare Voices
+void ToneBank::prepareVoices() {
+    // Build the shared wavetables here rather than on the audio thread
+    for (int waveType = 0; waveType < SIMDToneEngine::numWaveTypes; ++waveType) {
+        Wavetable::forWaveType(waveType);
+    }
+
+    // Stolen tones fade out in the spare slots while their replacements start
+    const int capacity = polyphony + stealingHeadroom;
+
+    tones.prepare(capacity);
+    engine.prepare(capacity);
+    toneForNote.fill(nullptr);
+    noteForTone.assign(static_cast<size_t>(capacity), -1);
+    laneHandles.assign(static_cast<size_t>(capacity), 0);
+    activeTones.assign(static_cast<size_t>(capacity), nullptr);
+    ungroupedTones.assign(static_cast<size_t>(capacity), nullptr);
+    activeToneBuses.assign(static_cast<size_t>(capacity), 0);
+    envelopeEvents.assign(static_cast<size_t>(capacity), {});
+    laneSyncPositions.assign(static_cast<size_t>(capacity), 0);
+    numFadingTones = 0;
+
+    releasedTones.prepare(numReleasedLists, capacity);
+    tonesByNoteNumber.prepare(numMidiNotes, capacity);
+    tonesByLevel.prepare(capacity);
+
+    for (auto& workerEngine : workerEngines) {
+        workerEngine->prepare(std::min(polyphony, parallelVoicesPerChunk));
+    }
+}
+
+// Prepare Mix Buffer
+void ToneBank::prepareMixBuffer() {
+    std::get<juce::AudioBuffer<float>>(mixBuffers).setSize(maxMixChannels + 1, passSize);
+    std::get<juce::AudioBuffer<double>>(mixBuffers).setSize(maxMixChannels + 1, passSize);
+}
+
+// Set Parallel Rendering
+void ToneBank::setParallelRendering(int numWorkerThreads, int voiceThreshold) {
+    numParallelWorkers = std::max(0, numWorkerThreads);
+    parallelVoiceThreshold = voiceThreshold;
+    prepareParallelRendering();
+}
+
+// Prepare Parallel Rendering
+void ToneBank::prepareParallelRendering() {
+    // Nothing to start, and nothing running to stop
+    if (numParallelWorkers == 0 && parallelRenderer.getNumWorkers() == 0) {
+        return;
+    }
+
+    parallelRenderer.prepare(numParallelWorkers, maxMixChannels, passSize, sampleRate);
+
+    // Every worker packs its chunk into its own engine, so no lanes are shared between threads
+    workerEngines.clear();
+
+    for (int i = 0; i < numParallelWorkers; ++i) {
+        workerEngines.push_back(std::make_unique<SIMDToneEngine>());
+        workerEngines.back()->prepare(std::min(polyphony, parallelVoicesPerChunk));
     }
 }
 
@@ -156,74 +436,735 @@ void ToneBank::setWaveType(Tone::WaveType waveType) {
     // Hence, no iteration through existing tones
 }
 
+// Set Envelope
+void ToneBank::setEnvelope(const EnvelopeParameters& newEnvelopeParameters) {
+    if (newEnvelopeParameters == envelopeParameters) {
+        return;
+    }
+
+    envelopeParameters = newEnvelopeParameters;
+    updateEnvelopeCoefficients();
+}
+
+// Set Envelope (Prepared)
+void ToneBank::setEnvelope(const EnvelopeParameters& newEnvelopeParameters, const EnvelopeCoefficients& preparedCoefficients) {
+    envelopeParameters = newEnvelopeParameters;
+    envelopeCoefficients = preparedCoefficients;
+}
+
+// Update Envelope Coefficients
+void ToneBank::updateEnvelopeCoefficients() {
+    // Times become sample counts and per-sample multipliers once, not per sample
+    envelopeCoefficients = EnvelopeCoefficients::calculate(envelopeParameters, sampleRate);
+}
+
+// Set Oscillator Mode
+void ToneBank::setOscillatorMode(Tone::OscillatorMode newOscillatorMode) {
+    // Unlike the wave type, this only changes how tones are computed, so playing tones follow it
+    // from the next render
+    oscillatorMode = newOscillatorMode;
+}
+
+// Update Tone Oscillator Mode
+template <typename SampleType>
+void ToneBank::updateToneOscillatorMode() {
+    rendersOnLanes = std::is_same_v<SampleType, float> && useSIMDEngine && oscillatorMode == Tone::Direct;
+    const auto mode = (economyOscillators && !rendersOnLanes) ? Tone::WavetableLinear : oscillatorMode;
+
+    if (mode == toneOscillatorMode) {
+        return;
+    }
+
+    toneOscillatorMode = mode;
+
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        tone->setOscillatorMode(toneOscillatorMode);
+    }
+}
+
+// Set Voice Limit
+void ToneBank::setVoiceLimit(int newVoiceLimit) {
+    voiceLimit = juce::jlimit(1, maxPolyphony, newVoiceLimit);
+    cullVoices(getVoiceLimit());
+}
+
+// Note Key
+int ToneBank::noteKey(int midiChannel, int noteNumber) {
+    jassert(midiChannel >= 1 && midiChannel <= numMidiChannels && juce::isPositiveAndBelow(noteNumber, numMidiNotes));
+
+    return (juce::jlimit(1, numMidiChannels, midiChannel) - 1) * numMidiNotes + juce::jlimit(0, numMidiNotes - 1, noteNumber);
+}
+
 // Note On
-void ToneBank::noteOn(float frequency, float velocity, Tone::WaveType waveType) {
-    // Check polyphony limit (5 tones)
-    if (tones.size() >= 5) {
-        tones.erase(tones.begin());
+void ToneBank::noteOn(int midiChannel, int noteNumber, float velocity, Tone::WaveType waveType) {
+    HW4_TRACE_EVENT(noteOn, midiChannel, noteNumber);
+
+    const int key = noteKey(midiChannel, noteNumber);
+
+    // Retrigger a key that is still sounding, even if it has been released, instead of stacking a second tone
+    if (auto* tone = toneForNote[static_cast<size_t>(key)]) {
+        const int index = tones.getIndex(tone);
+
+        tone->retrigger(velocity, envelopeCoefficients);
+        tones.moveToNewest(tone);
+        releasedTones.remove(index);
+        tonesByNoteNumber.remove(index);
+        tonesByNoteNumber.append(noteNumber, index);
+        tonesByLevel.setKey(index, tone->getLevel());
+        return;
     }
 
-    // Check if the tone is already playing (based on frequency)
-    bool toneAlreadyPlaying = false;
-    for (const auto& tonePtr : tones) {
-        if (std::abs(tonePtr->getFrequency() - frequency) < 0.1) { // Use getter
-            toneAlreadyPlaying = true;
-            break;
-        }
+    // Check polyphony limit. Tones already fading out don't count, and the stolen tone fades
+    // out too rather than being cut off mid-cycle.
+    if (tones.getNumActive() - numFadingTones >= getVoiceLimit()) {
+        auto* stolenTone = chooseToneToSteal(noteNumber);
+        HW4_TRACE_TONE(voiceSteal, stolenTone);
+        fadeOutTone(stolenTone);
     }
 
-    // If tone is not already playing, create a new Tone instance
-    if (!toneAlreadyPlaying) {
-        std::unique_ptr<Tone> newTone = std::make_unique<Tone>(
-            frequency,
+    // Only when a burst of steals has used up every spare slot: the fade that started first makes way
+    if (tones.getNumActive() == tones.getCapacity()) {
+        jassert(!releasedTones.isEmpty(fadingOut));
+        releaseTone(tones.getTone(releasedTones.getFirst(fadingOut)));
+    }
+
+    // Reuse a pooled Tone instead of allocating a new one
+    if (auto* tone = tones.acquire()) {
+        tone->start(
+            static_cast<float>(juce::MidiMessage::getMidiNoteInHertz(noteNumber)),
             velocity,
             waveType,       // Use the waveType passed to noteOn
             sampleRate,
-            ATTACK_FACTOR,
-            DECAY_FACTOR
+            envelopeCoefficients
         );
+        tone->setOscillatorMode(toneOscillatorMode);
+
+        const auto& part = channelParts[static_cast<size_t>(key / numMidiNotes)];
+        tone->setPan(part.pan);
+        tone->setGain(part.gain);
 
-        // Add the new Tone to the collection
-        tones.emplace_back(std::move(newTone));
+        const int index = tones.getIndex(tone);
+        toneForNote[static_cast<size_t>(key)] = tone;
+        noteForTone[static_cast<size_t>(index)] = key;
+        tonesByNoteNumber.append(noteNumber, index);
+        tonesByLevel.insert(index, tone->getLevel());
     }
 }
 
 // Note Off
-void ToneBank::noteOff(float frequency) {
-    for (auto& tonePtr : tones) {
-        if (std::abs(tonePtr->getFrequency() - frequency) < 0.1) { // Use getter
-            tonePtr->setReleased();
-            break; // Assuming unique tones; remove if multiple instances can exist
+void ToneBank::noteOff(int midiChannel, int noteNumber) {
+    HW4_TRACE_EVENT(noteOff, midiChannel, noteNumber);
+
+    auto* tone = toneForNote[static_cast<size_t>(noteKey(midiChannel, noteNumber))];
+
+    if (tone == nullptr || tone->hasBeenReleased()) {
+        return;
+    }
+
+    tone->setReleased();
+
+    const int index = tones.getIndex(tone);
+    releasedTones.append(releasedByNoteOff, index);
+    tonesByLevel.setKey(index, tone->getLevel());
+}
+
+// All Sound Off
+void ToneBank::allSoundOff() {
+    while (auto* tone = tones.getOldest()) {
+        releaseTone(tone);
+    }
+}
+
+// Channel Index
+int ToneBank::channelIndex(int midiChannel) {
+    jassert(midiChannel >= 1 && midiChannel <= numMidiChannels);
+
+    return juce::jlimit(1, numMidiChannels, midiChannel) - 1;
+}
+
+// Set Channel Pan
+void ToneBank::setChannelPan(int midiChannel, float pan) {
+    const int index = channelIndex(midiChannel);
+    const float channelPan = channelParts[static_cast<size_t>(index)].pan = juce::jlimit(-1.0f, 1.0f, pan);
+
+    // Pan moves are rare next to samples, so finding the channel's tones by scanning is fine
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        const int key = noteForTone[static_cast<size_t>(tones.getIndex(tone))];
+
+        if (key >= 0 && key / numMidiNotes == index) {
+            tone->setPan(channelPan);
+        }
+    }
+}
+
+// Set Channel Gain
+void ToneBank::setChannelGain(int midiChannel, float gain) {
+    const int index = channelIndex(midiChannel);
+    const float channelGain = channelParts[static_cast<size_t>(index)].gain = std::max(0.0f, gain);
+
+    // Like pan, volume changes are rare enough to scan for the channel's tones
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        const int key = noteForTone[static_cast<size_t>(tones.getIndex(tone))];
+
+        if (key >= 0 && key / numMidiNotes == index) {
+            tone->setGain(channelGain);
+        }
+    }
+}
+
+// Channel Wave Type
+void ToneBank::setChannelWaveType(int midiChannel, Tone::WaveType waveType) {
+    channelParts[static_cast<size_t>(channelIndex(midiChannel))].waveType = waveType;
+}
+
+Tone::WaveType ToneBank::getChannelWaveType(int midiChannel) const {
+    return channelParts[static_cast<size_t>(channelIndex(midiChannel))].waveType;
+}
+
+// Reset Channel Controllers
+void ToneBank::resetChannelControllers(int midiChannel) {
+    const ChannelPart defaults;
+    setChannelPan(midiChannel, defaults.pan);
+    setChannelGain(midiChannel, defaults.gain);
+}
+
+// Set Output Buses
+void ToneBank::setOutputBuses(const int* numChannelsPerBus, int numBuses) {
+    numOutputBuses = juce::jlimit(0, maxOutputBuses, numBuses);
+
+    for (int bus = 0; bus < maxOutputBuses; ++bus) {
+        busNumChannels[static_cast<size_t>(bus)] = bus < numOutputBuses ? std::max(0, numChannelsPerBus[bus]) : 0;
+    }
+
+    updateRenderBuses();
+}
+
+// Set Channel Output Bus
+void ToneBank::setChannelOutputBus(int midiChannel, int bus) {
+    channelParts[static_cast<size_t>(channelIndex(midiChannel))].outputBus = juce::jlimit(0, maxOutputBuses - 1, bus);
+    updateRenderBuses();
+}
+
+// Update Render Buses
+void ToneBank::updateRenderBuses() {
+    // Tones on a disabled or missing bus still play, through the main output
+    for (auto& part : channelParts) {
+        const bool busHasChannels = numOutputBuses == 0 ? part.outputBus == 0
+                                                        : (part.outputBus < numOutputBuses && busNumChannels[static_cast<size_t>(part.outputBus)] > 0);
+        part.renderBus = busHasChannels ? part.outputBus : 0;
+    }
+}
+
+// Choose Tone to Steal
+Tone* ToneBank::chooseToneToSteal(int noteNumber) const {
+    // Each policy reads the head of a list or heap, so choosing never scans the voices. Fading
+    // tones are in none of them and sit at the newest end of the pool, so none is chosen again.
+    int index = -1;
+
+    switch (stealingPolicy) {
+        case StealingPolicy::quietest:
+            index = tonesByLevel.getTop();
+            break;
+        case StealingPolicy::releasedFirst:
+            index = releasedTones.getFirst(releasedByNoteOff);
+            break;
+        case StealingPolicy::sameNote:
+            index = tonesByNoteNumber.getFirst(noteNumber);
+            break;
+        case StealingPolicy::oldest:
+        default:
+            break;
+    }
+
+    return index >= 0 ? tones.getTone(index) : tones.getOldest();
+}
+
+// Cull Voices
+void ToneBank::cullVoices(int maxVoices) {
+    // Tones already fading out are on their way and don't count against the cap again
+    int numVoices = 0;
+
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        if (!tone->isFadingOut()) {
+            ungroupedTones[static_cast<size_t>(numVoices++)] = tone;
         }
     }
+
+    const int numToCull = numVoices - maxVoices;
+
+    if (numToCull <= 0) {
+        return;
+    }
+
+    // Released before held, then quietest first; only which tones fall below the split matters, not their order
+    auto cullsFirst = [](const Tone* a, const Tone* b) {
+        if (a->hasBeenReleased() != b->hasBeenReleased()) {
+            return a->hasBeenReleased();
+        }
+
+        return a->getLevel() < b->getLevel();
+    };
+
+    const auto first = ungroupedTones.begin();
+    std::nth_element(first, first + numToCull, first + numVoices, cullsFirst);
+
+    for (int i = 0; i < numToCull; ++i) {
+        fadeOutTone(ungroupedTones[static_cast<size_t>(i)]);
+    }
+}
+
+// Fast Forward
+void ToneBank::fastForward(int numSamples) {
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        tone->skip(numSamples);
+    }
+
+    masterGain.skip(numSamples);
+    retireFinishedTones();
+}
+
+// Prepare Snapshot
+void ToneBank::prepareSnapshot(Snapshot& snapshot) const {
+    // Copying into an empty snapshot sizes its storage; later copies of the same size reuse it
+    copyState(snapshot);
+}
+
+// Save Snapshot
+void ToneBank::saveSnapshot(Snapshot& snapshot) const {
+    jassert(snapshot.tones.getCapacity() == tones.getCapacity());   // Call prepareSnapshot() first, off the audio thread
+
+    copyState(snapshot);
+}
+
+// Restore Snapshot
+bool ToneBank::restoreSnapshot(const Snapshot& snapshot) {
+    if (snapshot.tones.getCapacity() != tones.getCapacity() || snapshot.sampleRate != sampleRate) {
+        return false;
+    }
+
+    // Pools and lists refer to tones by index, so they copy straight across, even between banks
+    tones = snapshot.tones;
+    noteForTone = snapshot.noteForTone;
+    releasedTones = snapshot.releasedTones;
+    tonesByNoteNumber = snapshot.tonesByNoteNumber;
+    tonesByLevel = snapshot.tonesByLevel;
+    numFadingTones = snapshot.numFadingTones;
+    channelParts = snapshot.channelParts;
+    stealingPolicy = snapshot.stealingPolicy;
+    wavetype = snapshot.wavetype;
+    oscillatorMode = snapshot.oscillatorMode;
+    toneOscillatorMode = snapshot.toneOscillatorMode;
+    envelopeParameters = snapshot.envelopeParameters;
+    envelopeCoefficients = snapshot.envelopeCoefficients;
+    masterGain = snapshot.masterGain;
+
+    // The note index holds pointers into this bank's pool, so it is rebuilt rather than copied
+    toneForNote.fill(nullptr);
+
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        const int key = noteForTone[static_cast<size_t>(tones.getIndex(tone))];
+
+        if (key >= 0) {
+            toneForNote[static_cast<size_t>(key)] = tone;
+        }
+    }
+
+    // The bus layout belongs to this bank, not the snapshot
+    updateRenderBuses();
+    return true;
+}
+
+// Copy State
+void ToneBank::copyState(Snapshot& snapshot) const {
+    snapshot.tones = tones;
+    snapshot.noteForTone = noteForTone;
+    snapshot.releasedTones = releasedTones;
+    snapshot.tonesByNoteNumber = tonesByNoteNumber;
+    snapshot.tonesByLevel = tonesByLevel;
+    snapshot.numFadingTones = numFadingTones;
+    snapshot.channelParts = channelParts;
+    snapshot.stealingPolicy = stealingPolicy;
+    snapshot.wavetype = wavetype;
+    snapshot.oscillatorMode = oscillatorMode;
+    snapshot.toneOscillatorMode = toneOscillatorMode;
+    snapshot.sampleRate = sampleRate;
+    snapshot.envelopeParameters = envelopeParameters;
+    snapshot.envelopeCoefficients = envelopeCoefficients;
+    snapshot.masterGain = masterGain;
+}
+
+// Release Tone
+void ToneBank::releaseTone(Tone* tone) {
+    if (tone->isFadingOut()) {
+        --numFadingTones;
+    }
+
+    // Drop the tone from the note index and the stealing lists before the pool can hand it out again
+    forgetTone(tones.getIndex(tone));
+    tones.release(tone);
+}
+
+// Fade Out Tone
+void ToneBank::fadeOutTone(Tone* tone) {
+    if (tone->isFadingOut() || tone->shouldBeRemoved()) {
+        return;
+    }
+
+    // The tone stays in the pool until retireFinishedTones() sees the fade reach the cull floor,
+    // but is on its way out: a note-on for its key starts a fresh tone, and nothing steals it again
+    const int index = tones.getIndex(tone);
+    forgetTone(index);
+    releasedTones.append(fadingOut, index);
+    tones.moveToNewest(tone);
+
+    tone->fadeOut();
+    ++numFadingTones;
+}
+
+// Forget Tone
+void ToneBank::forgetTone(int index) {
+    auto& key = noteForTone[static_cast<size_t>(index)];
+
+    if (key >= 0) {
+        toneForNote[static_cast<size_t>(key)] = nullptr;
+        key = -1;
+    }
+
+    releasedTones.remove(index);
+    tonesByNoteNumber.remove(index);
+    tonesByLevel.remove(index);
 }
 
 // Render Buffer
-void ToneBank::renderBuffer(juce::AudioBuffer<float>& buffer) {
-    // Clear the buffer before rendering
-    buffer.clear();
-
-    // Iterate through each sample in the buffer
-    for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-        float mixedSample = 0.0f;
-
-        // Iterate through all active tones
-        for (auto it = tones.begin(); it != tones.end(); ) {
-            // Process the current tone and add its sample to mixedSample
-            it->get()->processSample(mixedSample);
-
-            // Check if the tone should be removed
-            if (it->get()->shouldBeRemoved()) {
-                it = tones.erase(it); // Remove the tone from active voices
+template <typename SampleType>
+void ToneBank::renderBuffer(juce::AudioBuffer<SampleType>& buffer) {
+    renderBuffer(buffer, 0, buffer.getNumSamples());
+}
+
+template <typename SampleType>
+void ToneBank::renderBuffer(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples) {
+    jassert(startSample >= 0 && startSample + numSamples <= buffer.getNumSamples());
+
+    updateToneOscillatorMode<SampleType>();
+
+    const int numVoices = collectActiveTones();
+
+    // Only mix in stereo when something is panned and a bus has somewhere to put it
+    const int widestBus = numOutputBuses > 0 ? *std::max_element(busNumChannels.begin(), busNumChannels.begin() + numOutputBuses)
+                                             : buffer.getNumChannels();
+    const int groupChannels = (anyTonePanned && widestBus > 1) ? 2 : 1;
+
+    // Render in passes no longer than the scratch mix, so it never leaves the cache
+    for (int offset = 0; offset < numSamples; offset += passSize) {
+        const int passSamples = std::min(passSize, numSamples - offset);
+        HW4_TRACE_SCOPE(renderPass, passSamples, numVoices);
+
+        renderMix<SampleType>(numVoices, groupChannels, passSamples);
+        writeMix(buffer, startSample + offset, groupChannels, passSamples);
+    }
+
+    retireFinishedTones();
+}
+
+// Render Mix
+template <typename SampleType>
+void ToneBank::renderMix(int numVoices, int groupChannels, int numSamples) {
+    auto* const* mix = std::get<juce::AudioBuffer<SampleType>>(mixBuffers).getArrayOfWritePointers();
+    const int numMixChannels = numMixGroups * groupChannels;
+
+    // Only the groups of buses with something playing are mixed at all
+    if (numMixGroups == 0) {
+        return;
+    }
+
+    for (int channel = 0; channel < numMixChannels; ++channel) {
+        juce::FloatVectorOperations::clear(mix[channel], numSamples);
+    }
+
+    // Voices render their whole block into the scratch mix, on several cores once there are enough of them
+    if (parallelRenderer.getNumWorkers() > 0 && numVoices >= parallelVoiceThreshold) {
+        // Workers follow whatever kernel the main engine has been switched to
+        for (auto& workerEngine : workerEngines) {
+            if (workerEngine->getInstructionSet() != engine.getInstructionSet()) {
+                workerEngine->setInstructionSet(engine.getInstructionSet());
+            }
+        }
+
+        parallelRenderer.render(*this, numVoices, parallelVoicesPerChunk, mix, numMixChannels, numSamples);
+    } else {
+        renderVoices(0, 0, numVoices, mix, numMixChannels, numSamples);
+    }
+}
+
+// Write Mix
+template <typename SampleType>
+void ToneBank::writeMix(juce::AudioBuffer<SampleType>& buffer, int startSample, int groupChannels, int numSamples) {
+    auto& mixBuffer = std::get<juce::AudioBuffer<SampleType>>(mixBuffers);
+    auto* gainRamp = mixBuffer.getWritePointer(maxMixChannels);
+
+    // The ramp is worked out once and shared by every channel, so they stay in step
+    const bool ramping = masterGain.isSmoothing();
+
+    if (ramping) {
+        for (int i = 0; i < numSamples; ++i) {
+            gainRamp[i] = static_cast<SampleType>(masterGain.getNextValue());
+        }
+    }
+
+    // Gain and fan-out in one pass that writes each output channel exactly once
+    const int numChannels = buffer.getNumChannels();
+    const int numBuses = std::max(1, numOutputBuses);
+    int busFirstChannel = 0;
+
+    for (int bus = 0; bus < numBuses && busFirstChannel < numChannels; ++bus) {
+        const int numBusChannels = numOutputBuses > 0 ? std::min(busNumChannels[static_cast<size_t>(bus)], numChannels - busFirstChannel)
+                                                      : numChannels;
+        const int group = groupForBus[static_cast<size_t>(bus)];
+
+        for (int busChannel = 0; busChannel < numBusChannels; ++busChannel) {
+            auto* out = buffer.getWritePointer(busFirstChannel + busChannel, startSample);
+
+            if (group < 0) {
+                juce::FloatVectorOperations::clear(out, numSamples);
+                continue;
+            }
+
+            // A mono bus takes both sides of a stereo mix, halved so centred tones stay at unity
+            if (numBusChannels == 1 && groupChannels == 2) {
+                juce::FloatVectorOperations::add(out, mixBuffer.getReadPointer(group * 2), mixBuffer.getReadPointer(group * 2 + 1), numSamples);
+
+                if (ramping) {
+                    juce::FloatVectorOperations::multiply(out, gainRamp, numSamples);
+                    juce::FloatVectorOperations::multiply(out, static_cast<SampleType>(0.5), numSamples);
+                } else {
+                    juce::FloatVectorOperations::multiply(out, static_cast<SampleType>(0.5f * masterGain.getTargetValue()), numSamples);
+                }
+
+                continue;
+            }
+
+            const auto* mix = mixBuffer.getReadPointer(group * groupChannels + busChannel % groupChannels);
+
+            if (ramping) {
+                juce::FloatVectorOperations::multiply(out, mix, gainRamp, numSamples);
             } else {
-                ++it; // Move to the next tone
+                juce::FloatVectorOperations::multiply(out, mix, static_cast<SampleType>(masterGain.getTargetValue()), numSamples);
             }
         }
 
-        // Write the mixed sample to both left and right channels
-        buffer.setSample(0, sample, mixedSample); // Left channel
-        buffer.setSample(1, sample, mixedSample); // Right channel
+        busFirstChannel += numBusChannels;
+    }
+
+    // Channels past the declared buses are silent
+    for (int channel = busFirstChannel; channel < numChannels; ++channel) {
+        juce::FloatVectorOperations::clear(buffer.getWritePointer(channel, startSample), numSamples);
+    }
+}
+
+// Collect Active Tones
+int ToneBank::collectActiveTones() {
+    // A flat array lets the voices be split into chunks; oldest first keeps the mixing order
+    int numVoices = 0;
+    anyTonePanned = false;
+
+    for (auto* tone = tones.getOldest(); tone != nullptr; tone = tones.getNext(tone)) {
+        const int key = noteForTone[static_cast<size_t>(tones.getIndex(tone))];
+
+        activeToneBuses[static_cast<size_t>(numVoices)] = key >= 0 ? channelParts[static_cast<size_t>(key / numMidiNotes)].renderBus : 0;
+        activeTones[static_cast<size_t>(numVoices++)] = tone;
+        anyTonePanned = anyTonePanned || tone->isPanned();
+    }
+
+    groupTonesByBus(numVoices);
+    return numVoices;
+}
+
+// Group Tones by Bus
+void ToneBank::groupTonesByBus(int numVoices) {
+    std::array<int, maxOutputBuses> counts {};
+
+    for (int voice = 0; voice < numVoices; ++voice) {
+        ++counts[static_cast<size_t>(activeToneBuses[static_cast<size_t>(voice)])];
+    }
+
+    // One mix group per bus with tones on it; the counts become each group's write position
+    groupForBus.fill(-1);
+    numMixGroups = 0;
+    int groupStart = 0;
+
+    for (int bus = 0; bus < maxOutputBuses; ++bus) {
+        auto& count = counts[static_cast<size_t>(bus)];
+
+        if (count == 0) {
+            continue;
+        }
+
+        groupForBus[static_cast<size_t>(bus)] = numMixGroups;
+        busForGroup[static_cast<size_t>(numMixGroups)] = bus;
+        groupStarts[static_cast<size_t>(numMixGroups++)] = groupStart;
+
+        groupStart += count;
+        count = groupStart - count;
+    }
+
+    groupStarts[static_cast<size_t>(numMixGroups)] = numVoices;
+
+    // With every tone on one bus the snapshot is already grouped; otherwise a stable counting
+    // sort keeps each group oldest first
+    if (numMixGroups <= 1) {
+        return;
+    }
+
+    std::swap(activeTones, ungroupedTones);
+
+    for (int voice = 0; voice < numVoices; ++voice) {
+        auto& position = counts[static_cast<size_t>(activeToneBuses[static_cast<size_t>(voice)])];
+        activeTones[static_cast<size_t>(position++)] = ungroupedTones[static_cast<size_t>(voice)];
+    }
+}
+
+// Retire Finished Tones
+void ToneBank::retireFinishedTones() {
+    // Once per block, after every thread is done; nothing is shifted or freed
+    for (auto* tone = tones.getOldest(); tone != nullptr; ) {
+        auto* nextTone = tones.getNext(tone);
+
+        if (tone->shouldBeRemoved()) {
+            HW4_TRACE_TONE(voiceRetire, tone);
+            releaseTone(tone);
+        }
+
+        tone = nextTone;
+    }
+}
+
+// Render Voices
+void ToneBank::renderVoices(int participant, int firstVoice, int lastVoice, float* const* mix, int numMixChannels, int numSamples) {
+    renderGroups(participant, firstVoice, lastVoice, mix, numMixChannels, numSamples);
+}
+
+void ToneBank::renderVoices(int participant, int firstVoice, int lastVoice, double* const* mix, int numMixChannels, int numSamples) {
+    renderGroups(participant, firstVoice, lastVoice, mix, numMixChannels, numSamples);
+}
+
+// Render Groups
+template <typename SampleType>
+void ToneBank::renderGroups(int participant, int firstVoice, int lastVoice, SampleType* const* mix, int numMixChannels, int numSamples) {
+    HW4_TRACE_SCOPE(voiceChunk, participant, lastVoice - firstVoice);
+
+    // A chunk of voices can straddle groups; each piece goes to its own group's mix channels
+    const int groupChannels = numMixChannels / numMixGroups;
+    int group = 0;
+
+    while (group < numMixGroups - 1 && groupStarts[static_cast<size_t>(group + 1)] <= firstVoice) {
+        ++group;
+    }
+
+    for (; group < numMixGroups && groupStarts[static_cast<size_t>(group)] < lastVoice; ++group) {
+        const int start = std::max(firstVoice, groupStarts[static_cast<size_t>(group)]);
+        const int end = std::min(lastVoice, groupStarts[static_cast<size_t>(group + 1)]);
+
+        renderGroup(participant, start, end, mix + group * groupChannels, groupChannels, numSamples);
+    }
+}
+
+// Render Group
+void ToneBank::renderGroup(int participant, int firstVoice, int lastVoice, float* const* mix, int groupChannels, int numSamples) {
+    if (useSIMDEngine && oscillatorMode == Tone::Direct) {
+        auto& laneEngine = participant == 0 ? engine : *workerEngines[static_cast<size_t>(participant - 1)];
+        renderLanes(laneEngine, firstVoice, lastVoice, mix, groupChannels, numSamples);
+    } else {
+        renderTones(firstVoice, lastVoice, mix, groupChannels, numSamples);
+    }
+}
+
+void ToneBank::renderGroup(int, int firstVoice, int lastVoice, double* const* mix, int groupChannels, int numSamples) {
+    // The SIMD lanes are float, so the double path always renders tone by tone
+    renderTones(firstVoice, lastVoice, mix, groupChannels, numSamples);
+}
+
+// Render Tones one at a time
+template <typename SampleType>
+void ToneBank::renderTones(int firstVoice, int lastVoice, SampleType* const* mix, int numMixChannels, int numSamples) {
+    SampleType* right = numMixChannels > 1 ? mix[1] : nullptr;
+
+    for (int voice = firstVoice; voice < lastVoice; ++voice) {
+        activeTones[static_cast<size_t>(voice)]->renderBlock(mix[0], right, numSamples);
+    }
+}
+
+// Render Tones as SIMD lanes
+void ToneBank::renderLanes(SIMDToneEngine& laneEngine, int firstVoice, int lastVoice, float* const* mix, int numMixChannels, int numSamples) {
+    float* left = mix[0];
+    float* right = numMixChannels > 1 ? mix[1] : nullptr;
+    auto renderTo = [&] (int start, int end) {
+        laneEngine.render(left + start, right != nullptr ? right + start : nullptr, end - start);
+    };
+
+    // Pending segment boundaries, soonest first; each chunk's heap lives in its own voices' slots
+    auto* events = envelopeEvents.data() + firstVoice;
+    int numEvents = 0;
+
+    auto soonestFirst = [] (const EnvelopeEvent& a, const EnvelopeEvent& b) { return a.position > b.position; };
+
+    // Pack the tones into the engine's structure-of-arrays lanes
+    laneEngine.clear();
+
+    for (int voice = firstVoice; voice < lastVoice; ++voice) {
+        auto* tone = activeTones[static_cast<size_t>(voice)];
+
+        laneHandles[static_cast<size_t>(voice)] = laneEngine.addVoice(tone->getWaveType(), tone->getLaneState(right != nullptr));
+        laneSyncPositions[static_cast<size_t>(voice)] = 0;
+
+        const int boundary = tone->getSamplesUntilEnvelopeChange();
+
+        if (boundary < numSamples) {
+            events[numEvents++] = { boundary, voice };
+        }
+    }
+
+    std::make_heap(events, events + numEvents, soonestFirst);
+
+    // Render every lane up to the next boundary, then give the lanes that reached it their next segment
+    int renderedUpTo = 0;
+
+    while (numEvents > 0) {
+        const auto event = events[0];
+        std::pop_heap(events, events + numEvents--, soonestFirst);
+
+        if (event.position > renderedUpTo) {
+            renderTo(renderedUpTo, event.position);
+            renderedUpTo = event.position;
+        }
+
+        auto* tone = activeTones[static_cast<size_t>(event.voice)];
+        const int handle = laneHandles[static_cast<size_t>(event.voice)];
+        auto& syncPosition = laneSyncPositions[static_cast<size_t>(event.voice)];
+
+        tone->setLaneState(laneEngine.getVoice(handle), event.position - syncPosition);
+        laneEngine.setVoice(handle, tone->getLaneState(right != nullptr));
+        syncPosition = event.position;
+
+        const int boundary = tone->getSamplesUntilEnvelopeChange();
+
+        if (boundary < numSamples - event.position) {
+            events[numEvents++] = { event.position + boundary, event.voice };
+            std::push_heap(events, events + numEvents, soonestFirst);
+        }
+    }
+
+    if (renderedUpTo < numSamples) {
+        renderTo(renderedUpTo, numSamples);
+    }
+
+    // Read the advanced state back
+    for (int voice = firstVoice; voice < lastVoice; ++voice) {
+        activeTones[static_cast<size_t>(voice)]->setLaneState(laneEngine.getVoice(laneHandles[static_cast<size_t>(voice)]),
+                                                              numSamples - laneSyncPositions[static_cast<size_t>(voice)]);
     }
-    
-    buffer.applyGain(masterGain);
 }
+
+template void ToneBank::renderBuffer<float>(juce::AudioBuffer<float>&);
+template void ToneBank::renderBuffer<double>(juce::AudioBuffer<double>&);
+template void ToneBank::renderBuffer<float>(juce::AudioBuffer<float>&, int, int);
+template void ToneBank::renderBuffer<double>(juce::AudioBuffer<double>&, int, int);
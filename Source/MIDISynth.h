@@ -10,65 +10,377 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "SIMDToneEngine.h"
+#include "PhaseAccumulator.h"
+#include "Wavetable.h"
+#include "ParallelVoiceRenderer.h"
+#include "VoiceLists.h"
+#include "Envelope.h"
 
 class Tone
 {
 public:
     enum WaveType {Sine, Square, Sawtooth};
+    enum OscillatorMode {Direct, WavetableLinear, WavetableCubic};
+    static constexpr int numWaveTypes = 3;
+    static constexpr int numOscillatorModes = 3;
     
-    Tone(float frequency, float velocity, WaveType waveType, double sampleRate, double attackFactor, double decayFactor);
+    Tone();
     ~Tone();
     
+    // (Re)initialises the tone in place so pooled voices can be reused without allocating
+    void start(float newFrequency, float newVelocity, WaveType newWaveType, double newSampleRate, const EnvelopeCoefficients& envelopeCoefficients);
+    // Restarts the envelope of a sounding tone without resetting its phase or gain, so it doesn't click
+    void retrigger(float newVelocity, const EnvelopeCoefficients& envelopeCoefficients);
     void setSampleRate(double newSampleRate);
     void setWaveType(WaveType newWaveType);
+    void setOscillatorMode(OscillatorMode newOscillatorMode);
     void setFrequency(double newFrequency);
-    void setGain (double newGain);
     void setReleased();
-    void updateTone();
+    // Releases over a few milliseconds, for voices shed to lighten the load
+    void fadeOut();
+    // -1 is hard left, 0 centre, 1 hard right
+    void setPan(float newPan);
+    // Linear output gain, applied in mono and stereo alike
+    void setGain(float newGain);
     void processSample(float& sample);
+    // Moves the phase and envelope on by numSamples as if they had been rendered
+    void skip(int numSamples);
+    // Adds the tone to outLeft, or panned to outLeft and outRight when outRight isn't null.
+    // Instantiated for float and double; each computes in its own precision throughout.
+    template <typename SampleType>
+    void renderBlock(SampleType* outLeft, SampleType* outRight, int numSamples);
     bool shouldBeRemoved() const;
     
     double getFrequency() const { return frequency; }
+    WaveType getWaveType() const { return waveType; }
+    bool isPanned() const { return pan != 0.0f; }
+    bool hasBeenReleased() const { return envelope.isReleased(); }
+    bool isFadingOut() const { return envelope.isFadingOut(); }
+    // The level a held tone is heading for, or a releasing tone's current gain; used to pick quiet voices to steal
+    float getLevel() const { return static_cast<float>(envelope.isReleased() ? envelope.getGain() : envelope.getPeak()); }
+    // Samples until the envelope changes segment; lanes have to be repacked at that point
+    int getSamplesUntilEnvelopeChange() const { return envelope.getSamplesUntilNextStage(); }
+
+    // Packs the oscillator and envelope state into a SIMDToneEngine lane and back. The lane
+    // must not have run past the current envelope segment.
+    ToneLaneState getLaneState(bool stereo) const;
+    void setLaneState(const ToneLaneState& state, int numSamplesRendered);
 
     
 private:
     WaveType waveType;
+    OscillatorMode oscillatorMode = Direct;
     double frequency;
-    bool isReleased = false;
-    double gain, velocity;
-    long long counter;
+    Envelope envelope;
+    float pan = 0.0f, gain = 1.0f, panLeft = 1.0f, panRight = 1.0f;
+    PhaseAccumulator::Phase phase, phaseIncrement;
     double sampleRate;
-    double attackFactor;
-    double decayFactor;
     
-    float generateWaveSample();
-    void updateCounter();
+    void updatePhaseIncrement();
+    void updateOutputGains();
     
 };
 
-class ToneBank 
+// Fixed-capacity pool of tones. All storage is allocated in prepare(); acquire() and
+// release() are O(1) and never allocate or move tones, so they are safe on the audio thread.
+// Active tones are kept in an intrusive list ordered from oldest to newest.
+class TonePool
+{
+public:
+    void prepare(int newCapacity);
+    void reset();
+
+    Tone* acquire();
+    void release(Tone* tone);
+    void moveToNewest(Tone* tone);
+
+    Tone* getOldest() const { return toneOrNull(activeList.getFirst(0)); }
+    Tone* getNext(const Tone* tone) const { return toneOrNull(activeList.getNext(indexOf(tone))); }
+
+    int getNumActive() const { return numActive; }
+    int getCapacity() const { return static_cast<int>(tones.size()); }
+    int getIndex(const Tone* tone) const { return indexOf(tone); }
+    Tone* getTone(int index) const { return tonesAt(index); }
+
+private:
+    std::vector<Tone> tones;
+    std::vector<int> freeList;          // Stack of free tone indices
+    IndexListSet activeList;            // A single list of the active tones
+    int numFree = 0, numActive = 0;
+
+    Tone* tonesAt(int index) const { return const_cast<Tone*>(tones.data() + index); }
+    Tone* toneOrNull(int index) const { return index >= 0 ? tonesAt(index) : nullptr; }
+    int indexOf(const Tone* tone) const { return static_cast<int>(tone - tones.data()); }
+};
+
+class ToneBank : private ParallelVoiceRenderer::Job
 {
 public:
     ToneBank();
     ~ToneBank();
     
-    void prepareToPlay(double newSampleRate);
+    void prepareToPlay(double newSampleRate, int newMaximumBlockSize = defaultMaximumBlockSize);
     void setWaveType(Tone::WaveType waveType);
-    void noteOn(float frequency, float velocity, Tone::WaveType wavetype);
-    void noteOff(float frequency);
-    void renderBuffer(juce::AudioBuffer<float>& buffer);
+    void setOscillatorMode(Tone::OscillatorMode newOscillatorMode);
+    // Voices are keyed by MIDI channel (1-16) and note number; a note-on for a sounding key retriggers it.
+    // Velocity is normalised, 0-1.
+    void noteOn(int midiChannel, int noteNumber, float velocity, Tone::WaveType wavetype);
+    void noteOff(int midiChannel, int noteNumber);
+    // Cuts every tone off at once, skipping the release (MIDI All Sound Off, or a host reset)
+    void allSoundOff();
+    // Pans the channel's sounding and future tones; -1 is hard left, 0 centre, 1 hard right
+    void setChannelPan(int midiChannel, float pan);
+    // Scales the channel's sounding and future tones
+    void setChannelGain(int midiChannel, float gain);
+    // Per-channel wave type for multi-timbral use; only stored here, for the caller to pass to noteOn()
+    void setChannelWaveType(int midiChannel, Tone::WaveType waveType);
+    Tone::WaveType getChannelWaveType(int midiChannel) const;
+    // Puts the channel's pan and gain back to centre and unity (MIDI Reset All Controllers)
+    void resetChannelControllers(int midiChannel);
+
+    // Splits the buffers passed to renderBuffer() into output buses laid out back to back, bus b
+    // taking numChannelsPerBus[b] channels. Until this is called the whole buffer is bus 0.
+    void setOutputBuses(const int* numChannelsPerBus, int numBuses);
+    // Routes a MIDI channel's tones to an output bus; buses without channels fall back to bus 0
+    void setChannelOutputBus(int midiChannel, int bus);
+
+    // Overwrites every channel of the buffer. Panned tones are only rendered in stereo when a bus
+    // has two or more channels; its even channels then take the left mix and odd ones the right.
+    // Every voice shares one pool and one render pass however many buses are in use; tones are
+    // grouped by bus and each group mixes into its own scratch channels.
+    // Instantiated for float and double. Float can use the SIMD lanes; double renders each tone
+    // in double precision.
+    template <typename SampleType>
+    void renderBuffer(juce::AudioBuffer<SampleType>& buffer);
+    // Renders only [startSample, startSample + numSamples), leaving the rest of the buffer untouched
+    template <typename SampleType>
+    void renderBuffer(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples);
     
     Tone::WaveType getCurrentWaveType() const { return wavetype; }
-    void setMasterGain(float newMasterGain) { masterGain = newMasterGain; }
+    Tone::OscillatorMode getOscillatorMode() const { return oscillatorMode; }
+    int getNumActiveVoices() const { return tones.getNumActive(); }
+    // Safe to call every block from the audio thread; the gain ramps towards the new value sample by sample
+    void setMasterGain(float newMasterGain) { masterGain.setTargetValue(newMasterGain); }
 
+    // Converted to per-sample coefficients here and in prepareToPlay(); new tones pick them up.
+    // Cheap to call every block: unchanged parameters are ignored.
+    void setEnvelope(const EnvelopeParameters& newEnvelopeParameters);
+    // Installs coefficients worked out elsewhere for the current sample rate, so nothing is recalculated here
+    void setEnvelope(const EnvelopeParameters& newEnvelopeParameters, const EnvelopeCoefficients& preparedCoefficients);
+    const EnvelopeParameters& getEnvelope() const { return envelopeParameters; }
+    double getSampleRate() const { return sampleRate; }
+
+    // Whole-bank snapshots, for seeking and for seeding segments of an offline render on other
+    // cores. prepareSnapshot() sizes one for this bank, allocating, and saves into it; after that
+    // saveSnapshot() and restoreSnapshot() only copy, so they are safe on the audio thread.
+    // A snapshot restores into any bank with the same polyphony and sample rate.
+    class Snapshot;
+    void prepareSnapshot(Snapshot& snapshot) const;
+    void saveSnapshot(Snapshot& snapshot) const;
+    bool restoreSnapshot(const Snapshot& snapshot);
+
+    // Moves every tone and the master gain ramp on by numSamples without producing any audio,
+    // then retires the tones that finished on the way
+    void fastForward(int numSamples);
+
+    // Which tone a note-on takes over once every voice is busy
+    enum class StealingPolicy
+    {
+        oldest,          // The tone started longest ago
+        quietest,        // The lowest level: a held tone's peak, or the gain a released tone began its release at
+        releasedFirst,   // The tone released longest ago, else the oldest
+        sameNote         // A tone playing the same note number on another channel, else the oldest
+    };
+
+    void setStealingPolicy(StealingPolicy newStealingPolicy) { stealingPolicy = newStealingPolicy; }
+    StealingPolicy getStealingPolicy() const { return stealingPolicy; }
+
+    // Takes effect at the next prepareToPlay(), which allocates the voices
+    void setPolyphony(int newPolyphony) { polyphony = juce::jlimit(1, maxPolyphony, newPolyphony); }
+    int getPolyphony() const { return polyphony; }
+
+    // Blocks of any size render in passes of at most this many samples, so the scratch mix and
+    // gain ramp stay in L1 however large the host's blocks are. Takes effect at the next
+    // prepareToPlay(), which sizes the scratch.
+    void setRenderQuantum(int newRenderQuantum) { renderQuantum = juce::jlimit(minRenderQuantum, maxRenderQuantum, newRenderQuantum); }
+    int getRenderQuantum() const { return renderQuantum; }
+
+    // A cap below the polyphony, for shedding load; no storage changes. Lowering it fades the
+    // excess out over a few milliseconds, released tones before held ones and quietest first,
+    // and note-ons then steal at the cap.
+    void setVoiceLimit(int newVoiceLimit);
+    int getVoiceLimit() const { return std::min(voiceLimit, polyphony); }
+
+    // Swaps in the cheapest oscillator close to the chosen one: linear wavetable lookups instead
+    // of computing the wave or cubic interpolation. Float Direct tones on the SIMD lanes are
+    // already the cheapest path and stay there, so canUseEconomyOscillators() is false while
+    // the last render went through them.
+    void setEconomyOscillators(bool shouldUseEconomyOscillators) { economyOscillators = shouldUseEconomyOscillators; }
+    bool isUsingEconomyOscillators() const { return economyOscillators; }
+    bool canUseEconomyOscillators() const { return !rendersOnLanes; }
+
+    static constexpr float defaultMasterGain = .0127f;
+    static constexpr double masterGainRampSeconds = .02;
+
+    // Renders through the SIMDToneEngine when enabled and the oscillator mode is Direct,
+    // otherwise one Tone at a time
+    void setUseSIMDEngine(bool shouldUseSIMDEngine) { useSIMDEngine = shouldUseSIMDEngine; }
+    bool isUsingSIMDEngine() const { return useSIMDEngine; }
+    SIMDToneEngine& getSIMDEngine() { return engine; }
+
+    // Spreads the voices over numWorkerThreads extra threads whenever at least
+    // voiceThreshold are playing; 0 workers renders everything on the audio thread.
+    // Starts and stops threads, so call it while the audio thread isn't rendering.
+    void setParallelRendering(int numWorkerThreads, int voiceThreshold);
+    int getNumParallelWorkers() const { return parallelRenderer.getNumWorkers(); }
+
+    static constexpr int defaultPolyphony = 5;
+    static constexpr int maxPolyphony = 4096;
+    static constexpr int stealingHeadroom = 32;   // Spare voices, beyond the polyphony, for stolen tones to fade out in
+    static constexpr int numMidiChannels = 16;
+    static constexpr int numMidiNotes = 128;
+    static constexpr int defaultMaximumBlockSize = 512;
+    static constexpr int defaultRenderQuantum = 128;   // 16 kB for a stereo double mix, with room for several buses
+    static constexpr int minRenderQuantum = 16;
+    static constexpr int maxRenderQuantum = 8192;
+    static constexpr int parallelVoicesPerChunk = 16;   // One AVX-512 register of lanes
+    static constexpr int maxOutputBuses = numMidiChannels;
+    static constexpr int maxMixChannels = ParallelVoiceRenderer::maxChannels;
+    static_assert(maxMixChannels >= 2 * maxOutputBuses, "Every bus needs room for a stereo mix");
 
-    
 private:
-    std::vector<std::unique_ptr<Tone>> tones;
+    TonePool tones;
+    SIMDToneEngine engine;
+    std::vector<int> laneHandles;   // Engine lane of each active tone, in pool order
+    std::vector<Tone*> activeTones; // Snapshot of the active list taken before each render, grouped by output bus
+    std::vector<Tone*> ungroupedTones;
+    std::vector<int> activeToneBuses;
+    bool anyTonePanned = false;     // Whether that snapshot needs a stereo mix
+
+    // Mix group g renders activeTones[groupStarts[g], groupStarts[g + 1]) for bus busForGroup[g]
+    std::array<int, maxOutputBuses + 1> groupStarts {};
+    std::array<int, maxOutputBuses> busForGroup {}, groupForBus {};
+    int numMixGroups = 1;
+
+    std::array<int, maxOutputBuses> busNumChannels {};   // Zero buses means the whole buffer is bus 0
+    int numOutputBuses = 0;
+
+    // Voices mix into this pass-sized scratch, which stays in cache, before the master gain and
+    // the fan-out to the output channels. There is one per sample type; the channel after the
+    // mix channels holds the master gain ramp.
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> mixBuffers;
+
+    struct ChannelPart
+    {
+        float pan = 0.0f, gain = 1.0f;
+        Tone::WaveType waveType = Tone::Sine;
+        int outputBus = 0;     // As requested
+        int renderBus = 0;     // After falling back for buses without channels
+    };
+
+    std::array<ChannelPart, numMidiChannels> channelParts;
+
+    // Envelope segment boundaries inside the block being rendered through the lanes
+    struct EnvelopeEvent
+    {
+        int position, voice;
+    };
+
+    std::vector<EnvelopeEvent> envelopeEvents;   // Per-chunk min-heaps, at most one pending event per voice
+    std::vector<int> laneSyncPositions;          // Where each lane's tone was last brought up to date
+
+    // (channel, note) -> sounding tone, and the key each pool slot is playing, so lookups never scan
+    std::array<Tone*, numMidiChannels * numMidiNotes> toneForNote {};
+    std::vector<int> noteForTone;
+
+    // Stealing candidates by pool slot: released tones oldest first, every tone by level, and tones per note number.
+    // Tones fading out are in none of these, only in their own list of releasedTones, oldest fade first.
+    // A tone's level is only rekeyed when its envelope changes segment on a note-on or note-off; the
+    // segment changes in between, attack to decay to sustain, leave a held tone's level at its peak.
+    IndexListSet releasedTones, tonesByNoteNumber;
+    IndexedMinHeap tonesByLevel;
+    enum ReleasedList {releasedByNoteOff, fadingOut, numReleasedLists};
+    int numFadingTones = 0;
+    StealingPolicy stealingPolicy = StealingPolicy::oldest;
+    int polyphony = defaultPolyphony;
+    int voiceLimit = maxPolyphony;
+    bool economyOscillators = false;
+    bool rendersOnLanes = false;    // Whether the last render took the SIMD lane path
+
+    ParallelVoiceRenderer parallelRenderer;
+    std::vector<std::unique_ptr<SIMDToneEngine>> workerEngines;   // One per worker thread
+    int numParallelWorkers = 0, parallelVoiceThreshold = 0;
+    int renderQuantum = defaultRenderQuantum;
+    int passSize = std::min(defaultMaximumBlockSize, defaultRenderQuantum);   // Samples per render pass, what the scratch holds
+    bool useSIMDEngine = true;
     Tone::WaveType wavetype;
+    Tone::OscillatorMode oscillatorMode;
+    Tone::OscillatorMode toneOscillatorMode;   // What the pooled tones are set to, after any economy swap
     double sampleRate;
-    double ATTACK_FACTOR, DECAY_FACTOR;
+    EnvelopeParameters envelopeParameters;
+    EnvelopeCoefficients envelopeCoefficients;
     
-    float masterGain; // Master gain scaling factor
+    juce::SmoothedValue<float> masterGain; // Master gain scaling factor
+
+    void updateEnvelopeCoefficients();
+
+    void prepareVoices();
+    void prepareMixBuffer();
+    void prepareParallelRendering();
+    int collectActiveTones();
+    void groupTonesByBus(int numVoices);
+    void updateRenderBuses();
+    static int channelIndex(int midiChannel);
+    void retireFinishedTones();
+    void copyState(Snapshot& snapshot) const;
+    void releaseTone(Tone* tone);
+    void fadeOutTone(Tone* tone);
+    void forgetTone(int index);
+    void cullVoices(int maxVoices);
+    template <typename SampleType>
+    void updateToneOscillatorMode();
+    Tone* chooseToneToSteal(int noteNumber) const;
+    static int noteKey(int midiChannel, int noteNumber);
+
+    template <typename SampleType>
+    void renderMix(int numVoices, int groupChannels, int numSamples);
+    template <typename SampleType>
+    void writeMix(juce::AudioBuffer<SampleType>& buffer, int startSample, int groupChannels, int numSamples);
+
+    void renderVoices(int participant, int firstVoice, int lastVoice, float* const* mix, int numMixChannels, int numSamples) override;
+    void renderVoices(int participant, int firstVoice, int lastVoice, double* const* mix, int numMixChannels, int numSamples) override;
+    template <typename SampleType>
+    void renderGroups(int participant, int firstVoice, int lastVoice, SampleType* const* mix, int numMixChannels, int numSamples);
+    void renderGroup(int participant, int firstVoice, int lastVoice, float* const* mix, int groupChannels, int numSamples);
+    void renderGroup(int participant, int firstVoice, int lastVoice, double* const* mix, int groupChannels, int numSamples);
+    template <typename SampleType>
+    void renderTones(int firstVoice, int lastVoice, SampleType* const* mix, int numMixChannels, int numSamples);
+    void renderLanes(SIMDToneEngine& laneEngine, int firstVoice, int lastVoice, float* const* mix, int numMixChannels, int numSamples);
 };
 
+// Everything the bank plays from: the voices with their phases and envelopes, the note and
+// stealing indices, the channel parts and the parameters. Render scratch isn't included; it is
+// rebuilt every block.
+class ToneBank::Snapshot
+{
+public:
+    bool isPrepared() const { return tones.getCapacity() > 0; }
+
+private:
+    friend class ToneBank;
+
+    TonePool tones;
+    std::vector<int> noteForTone;
+    IndexListSet releasedTones, tonesByNoteNumber;
+    IndexedMinHeap tonesByLevel;
+    int numFadingTones = 0;
+    std::array<ChannelPart, numMidiChannels> channelParts;
+    StealingPolicy stealingPolicy = StealingPolicy::oldest;
+    Tone::WaveType wavetype = Tone::Sine;
+    Tone::OscillatorMode oscillatorMode = Tone::Direct, toneOscillatorMode = Tone::Direct;
+    double sampleRate = 0.0;
+    EnvelopeParameters envelopeParameters;
+    EnvelopeCoefficients envelopeCoefficients;
+    juce::SmoothedValue<float> masterGain;
+};
@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    MidiInjectionQueue.cpp
+
+  ==============================================================================
+*/
+
+#include "MidiInjectionQueue.h"
+
+// Prepare
+void MidiInjectionQueue::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+    resetGeneration.fetch_add(1, std::memory_order_release);
+}
+
+// Push
+bool MidiInjectionQueue::push(Source source, const juce::MidiMessage& message) {
+    return push(source, message, now());
+}
+
+bool MidiInjectionQueue::push(Source source, const juce::MidiMessage& message, double timeInSeconds) {
+    const int size = message.getRawDataSize();
+
+    if (size > 3 || message.isSysEx() || message.isMetaEvent()) {
+        return false;
+    }
+
+    auto& queue = sources[static_cast<size_t>(source)];
+
+    if (queue.fifo.getFreeSpace() == 0) {
+        return false;
+    }
+
+    const juce::AbstractFifo::ScopedWrite write(queue.fifo, 1);
+    auto& queued = queue.messages[static_cast<size_t>(write.startIndex1)];
+    std::copy(message.getRawData(), message.getRawData() + size, queued.data.begin());
+    queued.size = size;
+    queued.time = timeInSeconds;
+    return true;
+}
+
+// Collect Block
+int MidiInjectionQueue::collectBlock(int numSamples) {
+    if (numSamples <= 0) {
+        return 0;
+    }
+
+    // Discarding from the consumer's end leaves the producers' write positions alone
+    const auto generation = resetGeneration.load(std::memory_order_acquire);
+
+    if (generation != drainedGeneration) {
+        drainedGeneration = generation;
+
+        for (auto& source : sources) {
+            source.fifo.finishedRead(source.fifo.getNumReady());
+        }
+    }
+
+    // Anything pushed after this instant waits for the next block, so every source is cut off at the same time
+    const double blockTime = now();
+
+    // Each source's ready messages without consuming them yet; they are contiguous apart from the wrap
+    std::array<int, numSources> readStart {}, numReady {}, numTaken {};
+
+    for (int source = 0; source < numSources; ++source) {
+        auto& fifo = sources[static_cast<size_t>(source)].fifo;
+        int start2 = 0, size1 = 0, size2 = 0;
+        fifo.prepareToRead(fifo.getNumReady(), readStart[static_cast<size_t>(source)], size1, start2, size2);
+        numReady[static_cast<size_t>(source)] = size1 + size2;
+    }
+
+    // Merge oldest first. Each source is already in time order, so this only compares the heads.
+    int numEvents = 0;
+
+    for (;;) {
+        const QueuedMessage* oldest = nullptr;
+        int oldestSource = -1;
+
+        for (int source = 0; source < numSources; ++source) {
+            const auto s = static_cast<size_t>(source);
+
+            if (numTaken[s] == numReady[s]) {
+                continue;
+            }
+
+            const auto& queued = sources[s].messages[static_cast<size_t>((readStart[s] + numTaken[s]) % capacityPerSource)];
+
+            if (queued.time <= blockTime && (oldest == nullptr || queued.time < oldest->time)) {
+                oldest = &queued;
+                oldestSource = source;
+            }
+        }
+
+        if (oldest == nullptr) {
+            break;
+        }
+
+        ++numTaken[static_cast<size_t>(oldestSource)];
+
+        // Played one block late at its original spacing; anything older than a block starts it
+        const int age = juce::roundToInt((blockTime - oldest->time) * sampleRate);
+        auto& event = events[static_cast<size_t>(numEvents++)];
+        event.message = juce::MidiMessage(oldest->data.data(), oldest->size);
+        event.samplePosition = juce::jlimit(0, numSamples - 1, numSamples - 1 - age);
+    }
+
+    for (int source = 0; source < numSources; ++source) {
+        sources[static_cast<size_t>(source)].fifo.finishedRead(numTaken[static_cast<size_t>(source)]);
+    }
+
+    return numEvents;
+}
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    MidiInjectionQueue.h
+
+    MIDI from outside the host's MidiBuffer: the editor's keyboard and
+    buttons, and a MIDI input device. This is not one multi-producer
+    queue: every source has its own single-producer single-consumer
+    AbstractFifo, so pushing is wait-free and the sources never contend.
+    Only the audio thread ever moves a FIFO's read position, including
+    when prepare() clears it. Once per block the audio thread takes
+    everything stamped before now, merges the sources oldest first and
+    maps each timestamp to a sample offset. Events land one block after
+    they were sent, at the same spacing they were sent with, so the
+    latency is constant and nothing is reordered.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class MidiInjectionQueue
+{
+public:
+    // Each source must only ever be pushed to from one thread at a time
+    enum Source {userInterface, midiInput, numSources};
+
+    static constexpr int capacityPerSource = 1024;
+
+    struct Event
+    {
+        juce::MidiMessage message;
+        int samplePosition = 0;
+    };
+
+    MidiInjectionQueue() = default;
+
+    // Drops anything queued. Producers may keep pushing: the FIFOs are emptied by the next
+    // collectBlock() rather than here, since resetting them would move the write positions too.
+    // Call while the audio thread isn't running.
+    void prepare(double newSampleRate);
+
+    // Producers. Only short channel messages are taken; sysex, meta events and a full queue
+    // return false. Timestamps are Time::getMillisecondCounterHiRes() / 1000, as MidiInput uses;
+    // the first form stamps the message with the time it was pushed.
+    bool push(Source source, const juce::MidiMessage& message);
+    bool push(Source source, const juce::MidiMessage& message, double timeInSeconds);
+
+    // Audio thread: takes the events sent up to now, oldest first, with positions in [0, numSamples)
+    int collectBlock(int numSamples);
+    const Event& getEvent(int index) const { return events[static_cast<size_t>(index)]; }
+
+    static double now() { return juce::Time::getMillisecondCounterHiRes() * 0.001; }
+
+private:
+    struct QueuedMessage
+    {
+        std::array<juce::uint8, 3> data;
+        int size;
+        double time;
+    };
+
+    struct SourceQueue
+    {
+        juce::AbstractFifo fifo { capacityPerSource };
+        std::array<QueuedMessage, capacityPerSource> messages;
+    };
+
+    std::array<SourceQueue, numSources> sources;
+    std::array<Event, numSources * capacityPerSource> events;
+    double sampleRate = 44100.0;
+
+    // Bumped by prepare(); collectBlock() drains the FIFOs when it sees a new generation
+    std::atomic<juce::uint32> resetGeneration { 0 };
+    juce::uint32 drainedGeneration = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiInjectionQueue)
+};
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    OutputAnalyser.cpp
+
+  ==============================================================================
+*/
+
+#include "OutputAnalyser.h"
+
+// Prepare
+void OutputAnalyser::prepare(double newSampleRate) {
+    decimationFactor = juce::jmax(1, static_cast<int>(std::ceil(newSampleRate / maxAnalysisRate)));
+    analysisRate.store(newSampleRate / decimationFactor, std::memory_order_relaxed);
+
+    decimationCount = 0;
+    decimationSum = 0.0f;
+    pendingSamples = 0;
+    droppedFrames.store(0, std::memory_order_relaxed);
+    fifo.reset();
+}
+
+// Push Block
+template <typename SampleType>
+void OutputAnalyser::pushBlock(const juce::AudioBuffer<SampleType>& buffer, int numVoices) {
+    const int numChannels = buffer.getNumChannels();
+
+    if (! active.load(std::memory_order_relaxed) || numChannels == 0) {
+        return;
+    }
+
+    // Each output is the mean of decimationFactor mono samples, a box filter that is plenty for display
+    const float scale = 1.0f / static_cast<float>(numChannels * decimationFactor);
+    const auto* const* channels = buffer.getArrayOfReadPointers();
+
+    for (int i = 0; i < buffer.getNumSamples(); ++i) {
+        SampleType sum = 0;
+
+        for (int channel = 0; channel < numChannels; ++channel) {
+            sum += channels[channel][i];
+        }
+
+        decimationSum += static_cast<float>(sum);
+
+        if (++decimationCount < decimationFactor) {
+            continue;
+        }
+
+        pendingFrame.samples[static_cast<size_t>(pendingSamples)] = decimationSum * scale;
+        decimationSum = 0.0f;
+        decimationCount = 0;
+
+        if (++pendingSamples == frameSize) {
+            publishPendingFrame(numVoices);
+        }
+    }
+}
+
+// Publish Pending Frame
+void OutputAnalyser::publishPendingFrame(int numVoices) {
+    pendingFrame.numVoices = numVoices;
+    pendingSamples = 0;
+
+    // Drop the frame rather than wait when the reader is behind
+    if (fifo.getFreeSpace() == 0) {
+        droppedFrames.store(droppedFrames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    const juce::AbstractFifo::ScopedWrite write(fifo, 1);
+    frames[static_cast<size_t>(write.startIndex1)] = pendingFrame;
+}
+
+// Read Frame
+bool OutputAnalyser::readFrame(Frame& destination) {
+    if (fifo.getNumReady() == 0) {
+        return false;
+    }
+
+    const juce::AbstractFifo::ScopedRead read(fifo, 1);
+    destination = frames[static_cast<size_t>(read.startIndex1)];
+    return true;
+}
+
+template void OutputAnalyser::pushBlock<float>(const juce::AudioBuffer<float>&, int);
+template void OutputAnalyser::pushBlock<double>(const juce::AudioBuffer<double>&, int);
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    OutputAnalyser.h
+
+    Feeds the editor's scope and spectrum from the audio thread. processBlock
+    mixes its output to mono, decimates it to at most maxAnalysisRate, and
+    publishes fixed-size frames (with the voice count at the time) through a
+    single-producer single-consumer AbstractFifo. Publishing never waits:
+    when the editor falls behind, or isn't open, frames are simply dropped.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class OutputAnalyser
+{
+public:
+    static constexpr int frameSize = 256;
+    static constexpr int numFrames = 32;   // About 170 ms at 48 kHz, several timer ticks of slack
+    static constexpr double maxAnalysisRate = 48000.0;
+
+    struct Frame
+    {
+        std::array<float, frameSize> samples;
+        int numVoices = 0;
+    };
+
+    OutputAnalyser() = default;
+
+    // Resets the decimator and drops queued frames; call while the audio thread isn't running
+    void prepare(double newSampleRate);
+
+    // Audio thread: nothing is analysed until a reader says it is listening
+    template <typename SampleType>
+    void pushBlock(const juce::AudioBuffer<SampleType>& buffer, int numVoices);
+
+    // Reader thread (the editor's timer)
+    void setActive(bool shouldBeActive) { active.store(shouldBeActive, std::memory_order_relaxed); }
+    bool readFrame(Frame& destination);
+    double getAnalysisRate() const { return analysisRate.load(std::memory_order_relaxed); }
+    juce::uint32 getNumDroppedFrames() const { return droppedFrames.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> active { false };
+    std::atomic<double> analysisRate { maxAnalysisRate };
+    std::atomic<juce::uint32> droppedFrames { 0 };
+
+    juce::AbstractFifo fifo { numFrames };
+    std::array<Frame, numFrames> frames;
+
+    // Audio thread only
+    Frame pendingFrame;
+    int pendingSamples = 0;
+    int decimationFactor = 1;
+    int decimationCount = 0;
+    float decimationSum = 0.0f;
+
+    void publishPendingFrame(int numVoices);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OutputAnalyser)
+};
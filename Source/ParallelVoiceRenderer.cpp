@@ -0,0 +1,294 @@
+/*
+  ==============================================================================
+
+    ParallelVoiceRenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "ParallelVoiceRenderer.h"
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr juce::uint64 packClaimState(juce::uint32 generation, juce::uint32 chunk) {
+        return (static_cast<juce::uint64>(generation) << 32) | chunk;
+    }
+
+    // Polls this many times after a job before parking: enough to catch the next pass of
+    // the same block without a wake-up, short enough not to hold a core between blocks
+    constexpr int spinsBeforeParking = 64;
+
+    // Chunks in flight usually land within a few microseconds, so the audio thread polls this
+    // long before going to sleep on them
+    constexpr int spinsBeforeWaiting = 2000;
+
+    // Tells the core it is in a spin loop, so it doesn't starve a sibling hyperthread
+    inline void spinPause() {
+       #if JUCE_INTEL
+        _mm_pause();
+       #else
+        std::this_thread::yield();
+       #endif
+    }
+}
+
+//==============================================================================
+class ParallelVoiceRenderer::Worker : public juce::Thread
+{
+public:
+    Worker(ParallelVoiceRenderer& ownerToUse, int participantToUse)
+        : juce::Thread("Voice Worker " + juce::String(participantToUse)),
+          owner(ownerToUse),
+          participant(participantToUse)
+    {
+    }
+
+    void run() override {
+        int idleSpins = 0;
+
+        while (!threadShouldExit()) {
+            if (owner.renderNextChunk(participant)) {
+                idleSpins = 0;
+                continue;
+            }
+
+            if (++idleSpins < spinsBeforeParking) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Park until the audio thread publishes more work. Announce it first and look once
+            // more, so a job published in between is either seen here or followed by a signal.
+            parked.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!owner.renderNextChunk(participant)) {
+                wakeUp.wait(-1);
+            }
+
+            parked.store(false);
+            idleSpins = 0;
+        }
+    }
+
+    // Called by the audio thread; only signals when the worker is actually asleep
+    void notify() {
+        if (parked.load()) {
+            wakeUp.signal();
+        }
+    }
+
+    void stop() {
+        signalThreadShouldExit();
+        wakeUp.signal();
+        stopThread(1000);
+    }
+
+private:
+    ParallelVoiceRenderer& owner;
+    const int participant;
+    std::atomic<bool> parked { false };
+    juce::WaitableEvent wakeUp;
+};
+
+//==============================================================================
+// Constructor Definition
+ParallelVoiceRenderer::ParallelVoiceRenderer()
+{
+}
+
+// Destructor Definition
+ParallelVoiceRenderer::~ParallelVoiceRenderer() {
+    release();
+}
+
+// Prepare Workers
+void ParallelVoiceRenderer::prepare(int numWorkerThreads, int numChannels, int maxBlockSize, double sampleRate) {
+    jassert(numWorkerThreads >= 0 && juce::isPositiveAndNotGreaterThan(numChannels, maxChannels) && maxBlockSize > 0);
+
+    release();
+
+    scratchChannels = numChannels;
+    scratchSamples = maxBlockSize;
+    std::get<juce::AudioBuffer<float>>(scratch).setSize((numWorkerThreads + 1) * scratchChannels, maxBlockSize);
+    std::get<juce::AudioBuffer<double>>(scratch).setSize((numWorkerThreads + 1) * scratchChannels, maxBlockSize);
+    scratchJobs.assign(static_cast<size_t>(numWorkerThreads + 1), 0);
+    claimState.store(packClaimState(generation, claimingClosed));
+
+    const int numCpus = juce::SystemStats::getNumCpus();
+    const auto realtimeOptions = juce::Thread::RealtimeOptions().withApproximateAudioProcessingTime(maxBlockSize, sampleRate);
+
+    for (int i = 0; i < numWorkerThreads; ++i) {
+        auto worker = std::make_unique<Worker>(*this, i + 1);
+
+        // Pin each worker to its own core, leaving the first one to the host's audio thread
+        worker->setAffinityMask(juce::uint32(1) << ((i + 1) % juce::jmin(numCpus, 32)));
+        worker->startRealtimeThread(realtimeOptions);
+
+        workers.push_back(std::move(worker));
+    }
+}
+
+// Release Workers
+void ParallelVoiceRenderer::release() {
+    for (auto& worker : workers) {
+        worker->stop();
+    }
+
+    workers.clear();
+}
+
+// Render
+template <typename SampleType>
+void ParallelVoiceRenderer::render(Job& job, int numVoices, int voicesPerChunk, SampleType* const* out, int numChannels, int numSamples) {
+    const int maxBlockSize = scratchSamples;
+    jassert(maxBlockSize > 0 && numChannels <= scratchChannels);
+
+    SampleType* passOut[maxChannels] = {};
+
+    for (int offset = 0; offset < numSamples; offset += maxBlockSize) {
+        for (int channel = 0; channel < numChannels; ++channel) {
+            passOut[channel] = out[channel] + offset;
+        }
+
+        renderPass(job, numVoices, voicesPerChunk, passOut, numChannels, juce::jmin(maxBlockSize, numSamples - offset));
+    }
+}
+
+template <typename SampleType>
+void ParallelVoiceRenderer::renderPass(Job& job, int numVoices, int voicesPerChunk, SampleType* const* out, int numChannels, int numSamples) {
+    const int numChunks = (numVoices + voicesPerChunk - 1) / voicesPerChunk;
+
+    // Close claiming for the old job before touching its parameters, so a late worker
+    // can never pair a stale claim with the new job
+    ++generation;
+    claimState.store(packClaimState(generation, claimingClosed));
+
+    currentJob.store(&job, std::memory_order_relaxed);
+    jobVoices.store(numVoices, std::memory_order_relaxed);
+    jobVoicesPerChunk.store(voicesPerChunk, std::memory_order_relaxed);
+    jobChunks.store(numChunks, std::memory_order_relaxed);
+    jobChannels.store(numChannels, std::memory_order_relaxed);
+    jobIsDouble.store(std::is_same_v<SampleType, double>, std::memory_order_relaxed);
+    jobSamples.store(numSamples, std::memory_order_relaxed);
+    completedChunks.store(0, std::memory_order_relaxed);
+
+    // Open the new job. The fence pairs with the one a parking worker makes, so every worker
+    // either sees the job or is seen as parked and signalled.
+    claimState.store(packClaimState(generation, 0), std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (auto& worker : workers) {
+        worker->notify();
+    }
+
+    // The audio thread works too, taking whatever chunks the workers haven't
+    while (renderNextChunk(0)) {
+    }
+
+    // Wait only for chunks that are already claimed and in flight. After a short spin, announce
+    // the wait and look once more, so the worker finishing the last chunk either is seen here or
+    // sees the announcement and signals; a stale signal only costs one more time round the loop.
+    for (int spins = 0; completedChunks.load(std::memory_order_acquire) < numChunks; ++spins) {
+        if (spins < spinsBeforeWaiting) {
+            spinPause();
+            continue;
+        }
+
+        audioThreadWaiting.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (completedChunks.load(std::memory_order_acquire) < numChunks) {
+            chunksCompleted.wait(-1);
+        }
+
+        audioThreadWaiting.store(false);
+    }
+
+    // Reduce every scratch buffer that was written during this job
+    const auto& jobScratch = std::get<juce::AudioBuffer<SampleType>>(scratch);
+
+    for (int participant = 0; participant < getNumParticipants(); ++participant) {
+        if (scratchJobs[static_cast<size_t>(participant)] == generation) {
+            for (int channel = 0; channel < numChannels; ++channel) {
+                juce::FloatVectorOperations::add(out[channel], jobScratch.getReadPointer(participant * scratchChannels + channel), numSamples);
+            }
+        }
+    }
+}
+
+// Claim and Render a Chunk
+bool ParallelVoiceRenderer::renderNextChunk(int participant) {
+    auto state = claimState.load(std::memory_order_acquire);
+    const auto jobGeneration = static_cast<juce::uint32>(state >> 32);
+
+    auto* job = currentJob.load(std::memory_order_relaxed);
+    const int numVoices = jobVoices.load(std::memory_order_relaxed);
+    const int voicesPerChunk = jobVoicesPerChunk.load(std::memory_order_relaxed);
+    const int numChunks = jobChunks.load(std::memory_order_relaxed);
+    const int numChannels = jobChannels.load(std::memory_order_relaxed);
+    const int numSamples = jobSamples.load(std::memory_order_relaxed);
+    const bool isDouble = jobIsDouble.load(std::memory_order_relaxed);
+
+    juce::uint32 chunk = 0;
+
+    // A successful CAS proves the parameters read above still belong to this job
+    for (;;) {
+        chunk = static_cast<juce::uint32>(state & 0xffffffffu);
+
+        if (static_cast<juce::uint32>(state >> 32) != jobGeneration || chunk >= static_cast<juce::uint32>(numChunks)) {
+            return false;
+        }
+
+        if (claimState.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+
+    const int firstVoice = static_cast<int>(chunk) * voicesPerChunk;
+    const int lastVoice = juce::jmin(numVoices, firstVoice + voicesPerChunk);
+
+    if (isDouble) {
+        renderChunk<double>(*job, participant, jobGeneration, firstVoice, lastVoice, numChannels, numSamples);
+    } else {
+        renderChunk<float>(*job, participant, jobGeneration, firstVoice, lastVoice, numChannels, numSamples);
+    }
+
+    // Whoever completes the last chunk wakes the audio thread if it has gone to sleep on it
+    if (completedChunks.fetch_add(1, std::memory_order_acq_rel) + 1 == numChunks && participant != 0) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (audioThreadWaiting.load()) {
+            chunksCompleted.signal();
+        }
+    }
+
+    return true;
+}
+
+// Render a Claimed Chunk
+template <typename SampleType>
+void ParallelVoiceRenderer::renderChunk(Job& job, int participant, juce::uint32 jobGeneration, int firstVoice, int lastVoice,
+                                        int numChannels, int numSamples) {
+    auto* const* out = std::get<juce::AudioBuffer<SampleType>>(scratch).getArrayOfWritePointers() + participant * scratchChannels;
+
+    // First chunk this participant takes in this job: start from silence
+    auto& scratchJob = scratchJobs[static_cast<size_t>(participant)];
+
+    if (scratchJob != jobGeneration) {
+        for (int channel = 0; channel < numChannels; ++channel) {
+            juce::FloatVectorOperations::clear(out[channel], numSamples);
+        }
+
+        scratchJob = jobGeneration;
+    }
+
+    job.renderVoices(participant, firstVoice, lastVoice, out, numChannels, numSamples);
+}
+
+template void ParallelVoiceRenderer::render<float>(Job&, int, int, float* const*, int, int);
+template void ParallelVoiceRenderer::render<double>(Job&, int, int, double* const*, int, int);
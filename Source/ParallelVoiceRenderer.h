@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    ParallelVoiceRenderer.h
+
+    Splits the voices of one block across a pool of pinned, realtime worker
+    threads. The audio thread publishes a job, workers and the audio thread
+    claim chunks of voices until none are left, each mixing into its own
+    preallocated scratch buffer, and the audio thread sums the scratch
+    buffers into the output.
+
+    Chunks come from one shared counter rather than per-worker deques with
+    stealing: a block's voices are a single flat range, so whoever is free
+    simply takes the next chunk. The audio thread never takes a lock: chunks
+    are claimed with a CAS, it renders any chunk a sleeping or late worker
+    doesn't pick up itself, and it only waits for chunks that have actually
+    been claimed, spinning briefly before sleeping until the last one lands.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class ParallelVoiceRenderer
+{
+public:
+    // Implemented by whoever owns the voices
+    struct Job
+    {
+        virtual ~Job() = default;
+
+        // Adds voices [firstVoice, lastVoice) into the numChannels scratch channels. participant is 0
+        // for the audio thread and 1..numWorkers for the workers, so jobs can keep per-thread state.
+        // The overload matches the sample type render() was called with.
+        virtual void renderVoices(int participant, int firstVoice, int lastVoice,
+                                  float* const* scratch, int numChannels, int numSamples) = 0;
+        virtual void renderVoices(int participant, int firstVoice, int lastVoice,
+                                  double* const* scratch, int numChannels, int numSamples) = 0;
+    };
+
+    // Voices are mixed to mono or stereo, once per output bus in use
+    static constexpr int maxChannels = 32;
+
+    ParallelVoiceRenderer();
+    ~ParallelVoiceRenderer();
+
+    // Starts the worker threads and allocates scratch; call off the audio thread. The block
+    // size and sample rate tell the OS how often the workers have to meet a deadline.
+    void prepare(int numWorkerThreads, int numChannels, int maxBlockSize, double sampleRate);
+    void release();
+
+    int getNumWorkers() const { return static_cast<int>(workers.size()); }
+    int getNumParticipants() const { return getNumWorkers() + 1; }
+
+    // Audio thread: renders numVoices voices in chunks of voicesPerChunk and adds them to the
+    // numChannels channels of out, which can be fewer than were prepared.
+    // Blocks longer than the scratch buffers are rendered in several passes.
+    // Instantiated for float and double.
+    template <typename SampleType>
+    void render(Job& job, int numVoices, int voicesPerChunk, SampleType* const* out, int numChannels, int numSamples);
+
+private:
+    class Worker;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    // scratchChannels channels per participant in each precision; only the one the job uses is touched
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> scratch;
+    int scratchChannels = 1, scratchSamples = 0;
+    std::vector<juce::uint32> scratchJobs;     // Job generation each participant's scratch holds
+
+    // High 32 bits are the job generation, low 32 bits the next unclaimed chunk
+    std::atomic<juce::uint64> claimState { 0 };
+    std::atomic<int> completedChunks { 0 };
+    std::atomic<bool> audioThreadWaiting { false };
+    juce::WaitableEvent chunksCompleted;
+
+    // Parameters of the current job, written only while claiming is closed
+    std::atomic<Job*> currentJob { nullptr };
+    std::atomic<int> jobVoices { 0 }, jobVoicesPerChunk { 1 }, jobChunks { 0 }, jobChannels { 1 }, jobSamples { 0 };
+    std::atomic<bool> jobIsDouble { false };
+
+    juce::uint32 generation = 0;
+
+    static constexpr juce::uint32 claimingClosed = 0xffffffffu;
+
+    bool renderNextChunk(int participant);
+
+    template <typename SampleType>
+    void renderPass(Job& job, int numVoices, int voicesPerChunk, SampleType* const* out, int numChannels, int numSamples);
+    template <typename SampleType>
+    void renderChunk(Job& job, int participant, juce::uint32 jobGeneration, int firstVoice, int lastVoice,
+                     int numChannels, int numSamples);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParallelVoiceRenderer)
+};
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.cpp
+
+  ==============================================================================
+*/
+
+#include "PerformanceMonitor.h"
+
+// Constructor Definition
+PerformanceMonitor::PerformanceMonitor()
+    : secondsPerTick(1.0 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()))
+{
+    prepare(sampleRate);
+}
+
+// Prepare
+void PerformanceMonitor::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+
+    for (auto& count : histogram) {
+        count.store(0);
+    }
+
+    processLoad.store(0.0f);
+    averageProcessLoad.store(0.0f);
+    renderLoad.store(0.0f);
+    deadlineMisses.store(0);
+    numBlocks.store(0);
+    numVoices.store(0);
+    peakVoices.store(0);
+}
+
+// Record Block
+float PerformanceMonitor::recordBlock(int numSamples, juce::int64 processTicks, juce::int64 renderTicks, int newNumVoices) {
+    if (numSamples <= 0) {
+        return 0.0f;
+    }
+
+    const double budgetSeconds = numSamples / sampleRate;
+    const auto load = static_cast<float>(static_cast<double>(processTicks) * secondsPerTick / budgetSeconds);
+
+    processLoad.store(load, std::memory_order_relaxed);
+    renderLoad.store(static_cast<float>(static_cast<double>(renderTicks) * secondsPerTick / budgetSeconds), std::memory_order_relaxed);
+
+    // One-pole average with a time constant of about a second of audio
+    const auto smoothing = static_cast<float>(std::min(1.0, budgetSeconds));
+    const float average = averageProcessLoad.load(std::memory_order_relaxed);
+    averageProcessLoad.store(average + (load - average) * smoothing, std::memory_order_relaxed);
+
+    const int bin = std::min(numBins - 1, static_cast<int>(load * binsPerUnitLoad));
+    increment(histogram[static_cast<size_t>(std::max(0, bin))]);
+
+    if (load > 1.0f) {
+        increment(deadlineMisses);
+    }
+
+    numVoices.store(newNumVoices, std::memory_order_relaxed);
+
+    if (newNumVoices > peakVoices.load(std::memory_order_relaxed)) {
+        peakVoices.store(newNumVoices, std::memory_order_relaxed);
+    }
+
+    // Published last, so a reader that sees the new count also sees this block's bin
+    numBlocks.store(numBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return load;
+}
+
+//==============================================================================
+// Read Snapshot
+PerformanceMonitor::Snapshot PerformanceMonitor::Reader::read(const PerformanceMonitor& monitor) {
+    Snapshot snapshot;
+    snapshot.numBlocks = monitor.numBlocks.load(std::memory_order_acquire);
+    snapshot.processLoad = monitor.processLoad.load(std::memory_order_relaxed);
+    snapshot.averageProcessLoad = monitor.averageProcessLoad.load(std::memory_order_relaxed);
+    snapshot.renderLoad = monitor.renderLoad.load(std::memory_order_relaxed);
+    snapshot.deadlineMisses = monitor.deadlineMisses.load(std::memory_order_relaxed);
+    snapshot.numVoices = monitor.numVoices.load(std::memory_order_relaxed);
+    snapshot.peakVoices = monitor.peakVoices.load(std::memory_order_relaxed);
+
+    // Blocks recorded since the last read; counts only grow until the next prepare()
+    std::array<juce::uint32, numBins> newCounts;
+    juce::uint64 total = 0;
+
+    for (size_t bin = 0; bin < newCounts.size(); ++bin) {
+        const auto count = monitor.histogram[bin].load(std::memory_order_relaxed);
+        newCounts[bin] = count >= previousCounts[bin] ? count - previousCounts[bin] : count;
+        previousCounts[bin] = count;
+        total += newCounts[bin];
+    }
+
+    // Keep showing the last value while no blocks are coming in
+    if (total == 0) {
+        snapshot.p99ProcessLoad = lastP99;
+        return snapshot;
+    }
+
+    const auto target = (total * 99 + 99) / 100;
+    juce::uint64 cumulative = 0;
+
+    for (size_t bin = 0; bin < newCounts.size(); ++bin) {
+        cumulative += newCounts[bin];
+
+        if (cumulative >= target) {
+            // Upper edge of the bin, so the estimate never understates the load
+            lastP99 = static_cast<float>(bin + 1) / binsPerUnitLoad;
+            break;
+        }
+    }
+
+    snapshot.p99ProcessLoad = lastP99;
+    return snapshot;
+}
@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.h
+
+    Real-time load statistics for processBlock and ToneBank rendering. The
+    audio thread is the only writer: it records each block's time against
+    its budget (numSamples / sampleRate) into relaxed atomics and a
+    histogram of load. Readers on other threads take snapshots without
+    locking; a Reader diffs consecutive histograms so its percentiles cover
+    only the blocks since its last read.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class PerformanceMonitor
+{
+public:
+    // Load is time spent / time available, so 1.0 is a missed deadline
+    static constexpr int binsPerUnitLoad = 200;   // 0.5% resolution
+    static constexpr int numBins = 2 * binsPerUnitLoad + 1;   // Up to 200%, plus an overflow bin
+
+    struct Snapshot
+    {
+        float processLoad = 0.0f;          // Most recent block
+        float averageProcessLoad = 0.0f;   // Smoothed over roughly the last second
+        float renderLoad = 0.0f;           // ToneBank::renderBuffer share of the most recent block
+        float p99ProcessLoad = 0.0f;       // Over the blocks since the reader's previous snapshot
+        juce::uint32 deadlineMisses = 0;
+        juce::uint64 numBlocks = 0;
+        int numVoices = 0, peakVoices = 0;
+    };
+
+    // Keeps the previous histogram so each snapshot reports only new blocks
+    class Reader
+    {
+    public:
+        Snapshot read(const PerformanceMonitor& monitor);
+
+    private:
+        std::array<juce::uint32, numBins> previousCounts {};
+        float lastP99 = 0.0f;
+    };
+
+    PerformanceMonitor();
+
+    // Resets every statistic; call while the audio thread isn't running
+    void prepare(double newSampleRate);
+
+    // Audio thread, once per processBlock; returns the block's load
+    float recordBlock(int numSamples, juce::int64 processTicks, juce::int64 renderTicks, int numVoices);
+
+    static juce::int64 now() { return juce::Time::getHighResolutionTicks(); }
+
+private:
+    std::array<std::atomic<juce::uint32>, numBins> histogram;
+    std::atomic<float> processLoad { 0.0f }, averageProcessLoad { 0.0f }, renderLoad { 0.0f };
+    std::atomic<juce::uint32> deadlineMisses { 0 };
+    std::atomic<juce::uint64> numBlocks { 0 };
+    std::atomic<int> numVoices { 0 }, peakVoices { 0 };
+
+    double sampleRate = 44100.0;
+    double secondsPerTick;
+
+    // Relaxed read-modify-writes are enough with a single writer
+    template <typename T>
+    static void increment(std::atomic<T>& counter) { counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceMonitor)
+};
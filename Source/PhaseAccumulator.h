@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    PhaseAccumulator.h
+
+    Helpers for the 32-bit fixed-point phase shared by every oscillator.
+    A full cycle is 2^32, so advancing is a single unsigned add that wraps
+    by itself, and the top bits are directly a wavetable index.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+namespace PhaseAccumulator
+{
+    using Phase = juce::uint32;
+
+    constexpr double cycleLength = 4294967296.0;   // 2^32
+    constexpr Phase halfCycle = 0x80000000u;
+
+    // Computed once per frequency or sample rate change; resolution is sampleRate / 2^32 Hz
+    inline Phase incrementFor(double frequency, double sampleRate)
+    {
+        const double cyclesPerSample = juce::jlimit(0.0, 0.5, frequency / sampleRate);
+        return static_cast<Phase>(std::llround(cyclesPerSample * cycleLength));
+    }
+
+    // Normalised phase in [0, 1)
+    inline double toDouble(Phase phase)
+    {
+        return static_cast<double>(phase) * (1.0 / cycleLength);
+    }
+
+    // Uses the top 24 bits so the conversion to float is exact
+    inline float toFloat(Phase phase)
+    {
+        return static_cast<float>(phase >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Splits the phase into an index into a 2^tableBits table and the fraction in between
+    template <int tableBits>
+    inline int tableIndex(Phase phase)
+    {
+        return static_cast<int>(phase >> (32 - tableBits));
+    }
+
+    template <int tableBits>
+    inline float tableFraction(Phase phase)
+    {
+        constexpr Phase fractionMask = (Phase(1) << (32 - tableBits)) - 1;
+        return static_cast<float>(phase & fractionMask) * (1.0f / static_cast<float>(Phase(1) << (32 - tableBits)));
+    }
+}
@@ -11,60 +11,218 @@
 
 //==============================================================================
 Hw4AudioProcessorEditor::Hw4AudioProcessorEditor (Hw4AudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), analyserView (p.getOutputAnalyser())
 {
-    // Initialize master gain slider
-    masterGainSlider.setSliderStyle(juce::Slider::LinearHorizontal);
-    masterGainSlider.setRange(0.0001f, 0.001f, 0.00001f); // Increment by 0.00001 for fine control
-    masterGainSlider.setValue(0.0001f); // Default value matching ToneBank
+    auto& parameters = audioProcessor.getParameters();
+
+    // Initialize master gain slider; the attachment supplies its range, skew and text
+    addLabelledSlider(masterGainSlider, masterGainLabel, "Master Gain");
     masterGainSlider.setTextValueSuffix(" Master Gain");
-    masterGainSlider.setNumDecimalPlacesToDisplay(6); // Display more decimal places
-    masterGainSlider.setSkewFactorFromMidPoint(0.00055f); // Optional: improves usability
-    masterGainSlider.addListener(this);
+    masterGainAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::masterGain.getParamID(), masterGainSlider);
 
-    // Optional: Format the displayed text
-    masterGainSlider.textFromValueFunction = [](double value)
-    {
-        return juce::String(value, 6);
-    };
+    // Envelope times
+    addLabelledSlider(attackSlider, attackLabel, "Attack");
+    attackAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::attack.getParamID(), attackSlider);
+
+    addLabelledSlider(decaySlider, decayLabel, "Decay");
+    decayAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::decay.getParamID(), decaySlider);
+
+    addLabelledSlider(sustainSlider, sustainLabel, "Sustain");
+    sustainAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::sustain.getParamID(), sustainSlider);
+
+    addLabelledSlider(releaseSlider, releaseLabel, "Release");
+    releaseAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::release.getParamID(), releaseSlider);
+
+    addLabelledSlider(cullFloorSlider, cullFloorLabel, "Cull Floor");
+    cullFloorAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::cullFloor.getParamID(), cullFloorSlider);
 
-    addAndMakeVisible(masterGainSlider);
+    // Wave type for new notes
+    waveTypeBox.addItemList({ "Sine", "Square", "Sawtooth" }, 1);
+    addAndMakeVisible(waveTypeBox);
+    waveTypeLabel.setText("Wave Type", juce::dontSendNotification);
+    waveTypeLabel.attachToComponent(&waveTypeBox, true);
+    addAndMakeVisible(waveTypeLabel);
+    waveTypeAttachment = std::make_unique<ComboBoxAttachment>(parameters, ParameterIDs::waveType.getParamID(), waveTypeBox);
+
+    // Which voice a note takes over once polyphony runs out
+    voiceStealingBox.addItemList({ "Oldest", "Quietest", "Released First", "Same Note" }, 1);
+    addAndMakeVisible(voiceStealingBox);
+    voiceStealingLabel.setText("Stealing", juce::dontSendNotification);
+    voiceStealingLabel.attachToComponent(&voiceStealingBox, true);
+    addAndMakeVisible(voiceStealingLabel);
+    voiceStealingAttachment = std::make_unique<ComboBoxAttachment>(parameters, ParameterIDs::voiceStealing.getParamID(), voiceStealingBox);
+
+    // How many voices there are to steal from; changing it restarts the synth
+    polyphonySlider.setSliderStyle(juce::Slider::IncDecButtons);
+    polyphonySlider.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 40, 20);
+    addAndMakeVisible(polyphonySlider);
+    polyphonyLabel.setText("Voices", juce::dontSendNotification);
+    polyphonyLabel.attachToComponent(&polyphonySlider, true);
+    addAndMakeVisible(polyphonyLabel);
+    polyphonyAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::polyphony.getParamID(), polyphonySlider);
+
+    // Extra cores for big chords; changing it restarts the synth
+    renderThreadsSlider.setSliderStyle(juce::Slider::IncDecButtons);
+    renderThreadsSlider.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 40, 20);
+    addAndMakeVisible(renderThreadsSlider);
+    renderThreadsLabel.setText("Threads", juce::dontSendNotification);
+    renderThreadsLabel.attachToComponent(&renderThreadsSlider, true);
+    addAndMakeVisible(renderThreadsLabel);
+    renderThreadsAttachment = std::make_unique<SliderAttachment>(parameters, ParameterIDs::renderThreads.getParamID(), renderThreadsSlider);
+
+    // Every MIDI channel as its own part
+    multiTimbralButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    addAndMakeVisible(multiTimbralButton);
+    multiTimbralAttachment = std::make_unique<ButtonAttachment>(parameters, ParameterIDs::multiTimbral.getParamID(), multiTimbralButton);
+
+    // Graceful degradation instead of dropouts when the CPU runs short
+    loadGovernorButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    addAndMakeVisible(loadGovernorButton);
+    loadGovernorAttachment = std::make_unique<ButtonAttachment>(parameters, ParameterIDs::loadGovernor.getParamID(), loadGovernorButton);
 
-    // Initialize master gain label
-    masterGainLabel.setText("Master Gain", juce::dontSendNotification);
-    masterGainLabel.attachToComponent(&masterGainSlider, true);
-    addAndMakeVisible(masterGainLabel);
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
     
-    waveformInstructionsLabel.setText(
-        "Waveform Selection:\n"
-        "C3: Sine Wave\n"
-        "D3: Square Wave\n"
-        "E3: Sawtooth Wave",
-        juce::dontSendNotification);
+    waveformInstructionsLabel.setText("C3 / D3 / E3 switch new notes to sine / square / sawtooth", juce::dontSendNotification);
     waveformInstructionsLabel.setJustificationType(juce::Justification::centred);
-    waveformInstructionsLabel.setFont(juce::Font(14.0f));
+    waveformInstructionsLabel.setFont(juce::Font(12.0f));
     waveformInstructionsLabel.setColour(juce::Label::textColourId, juce::Colours::white);
     addAndMakeVisible(waveformInstructionsLabel);
+
+    // On-screen keyboard over the range the wave switches sit in
+    keyboard.setAvailableRange(36, 96);
+    addAndMakeVisible(keyboard);
+    keyboardState.addListener(this);
+
+    // A local MIDI device, played alongside whatever the host sends
+    addAndMakeVisible(midiInputBox);
+    midiInputLabel.setText("MIDI Input", juce::dontSendNotification);
+    midiInputLabel.attachToComponent(&midiInputBox, true);
+    addAndMakeVisible(midiInputLabel);
+    updateMidiInputs();
+
+    midiInputBox.onChange = [this]
+    {
+        const int index = midiInputBox.getSelectedItemIndex() - 1;
+        audioProcessor.setMidiInputDevice(juce::isPositiveAndBelow(index, midiInputDevices.size()) ? midiInputDevices[index].identifier
+                                                                                                   : juce::String());
+    };
+
+    // Cuts every sounding voice, whichever source started it
+    addAndMakeVisible(panicButton);
+    panicButton.onClick = [this]
+    {
+        keyboardState.allNotesOff(0);
+
+        for (int channel = 1; channel <= ToneBank::numMidiChannels; ++channel)
+            audioProcessor.getMidiInjectionQueue().push(MidiInjectionQueue::userInterface, juce::MidiMessage::allSoundOff(channel));
+    };
+
+   #if HW4_TRACING
+    traceButton.setClickingTogglesState(true);
+    traceButton.setToggleState(TraceRecorder::isRecording(), juce::dontSendNotification);
+    addAndMakeVisible(traceButton);
+    traceButton.onClick = [this]
+    {
+        // Stopping finishes the file and shows it, ready to drop into Perfetto
+        if (! traceButton.getToggleState())
+        {
+            TraceRecorder::stop();
+            traceFile.revealToUser();
+            return;
+        }
+
+        traceFile = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getNonexistentChildFile("hw4-trace", ".json");
+
+        if (! TraceRecorder::start(traceFile))
+            traceButton.setToggleState(false, juce::dontSendNotification);
+    };
+   #endif
+
+    performanceLabel.setJustificationType(juce::Justification::centred);
+    performanceLabel.setFont(juce::Font(12.0f));
+    performanceLabel.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+    addAndMakeVisible(performanceLabel);
+
+    addAndMakeVisible(analyserView);
     
-    setSize (400, 300);
+    setSize (400, 664);
+
+    // A few refreshes a second is plenty to read and keeps the message thread idle
+    startTimerHz(4);
 }
 
 Hw4AudioProcessorEditor::~Hw4AudioProcessorEditor()
 {
-    masterGainSlider.removeListener(this);
+    stopTimer();
+
+    // Release any keys still held, so closing the editor doesn't leave notes hanging
+    keyboardState.allNotesOff(0);
+    keyboardState.removeListener(this);
+
+   #if HW4_TRACING
+    // Finish the file while there is still a button to have started it
+    if (traceButton.getToggleState())
+        TraceRecorder::stop();
+   #endif
 }
 
-void Hw4AudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
+void Hw4AudioProcessorEditor::addLabelledSlider(juce::Slider& slider, juce::Label& label, const juce::String& name)
 {
-    if (slider == &masterGainSlider)
+    slider.setSliderStyle(juce::Slider::LinearHorizontal);
+    addAndMakeVisible(slider);
+
+    label.setText(name, juce::dontSendNotification);
+    label.attachToComponent(&slider, true);
+    addAndMakeVisible(label);
+}
+
+void Hw4AudioProcessorEditor::timerCallback()
+{
+    const auto stats = performanceReader.read(audioProcessor.getPerformanceMonitor());
+    const auto& governor = audioProcessor.getLoadGovernor();
+    const auto governorLevel = governor.getLevel();
+
+    performanceLabel.setText(juce::String::formatted("CPU %.0f%% (synth %.0f%%)  p99 %.0f%%  misses %u  voices %d/%d",
+                                                     stats.averageProcessLoad * 100.0f,
+                                                     stats.renderLoad * 100.0f,
+                                                     stats.p99ProcessLoad * 100.0f,
+                                                     stats.deadlineMisses,
+                                                     stats.numVoices,
+                                                     stats.peakVoices)
+                             + (governorLevel != LoadGovernor::fullQuality ? "\nShedding load: " + LoadGovernor::describe(governorLevel, governor.isUsingEconomyOscillators()) : juce::String()),
+                             juce::dontSendNotification);
+}
+
+void Hw4AudioProcessorEditor::handleNoteOn(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
+{
+    audioProcessor.getMidiInjectionQueue().push(MidiInjectionQueue::userInterface, juce::MidiMessage::noteOn(midiChannel, midiNoteNumber, velocity));
+}
+
+void Hw4AudioProcessorEditor::handleNoteOff(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity)
+{
+    audioProcessor.getMidiInjectionQueue().push(MidiInjectionQueue::userInterface, juce::MidiMessage::noteOff(midiChannel, midiNoteNumber, velocity));
+}
+
+void Hw4AudioProcessorEditor::updateMidiInputs()
+{
+    midiInputDevices = juce::MidiInput::getAvailableDevices();
+    midiInputBox.clear(juce::dontSendNotification);
+    midiInputBox.addItem("None", 1);
+
+    const auto current = audioProcessor.getMidiInputDevice();
+    int selectedId = 1;
+
+    for (int i = 0; i < midiInputDevices.size(); ++i)
     {
-        float newMasterGain = static_cast<float>(slider->getValue());
-        audioProcessor.getToneBank().setMasterGain(newMasterGain);
+        midiInputBox.addItem(midiInputDevices[i].name, i + 2);
+
+        if (midiInputDevices[i].identifier == current)
+            selectedId = i + 2;
     }
-}
 
+    midiInputBox.setSelectedId(selectedId, juce::dontSendNotification);
+}
 
 //==============================================================================
 void Hw4AudioProcessorEditor::paint (juce::Graphics& g)
@@ -75,12 +233,33 @@ void Hw4AudioProcessorEditor::paint (juce::Graphics& g)
        // Draw a simple message
        g.setColour (juce::Colours::white);
        g.setFont (15.0f);
-       g.drawFittedText ("MIDI Synthesizer", getLocalBounds(), juce::Justification::centred, 1);
+       g.drawFittedText ("MIDI Synthesizer", getLocalBounds().withBottom (analyserView.getY()), juce::Justification::centred, 1);
 }
 
 void Hw4AudioProcessorEditor::resized()
 {
-    masterGainSlider.setBounds(100, 100, 200, 20);
-    waveformInstructionsLabel.setBounds(50, 150, 300, 100);
+    waveTypeBox.setBounds(100, 20, 130, 20);
+    renderThreadsSlider.setBounds(290, 20, 100, 20);
+    masterGainSlider.setBounds(100, 50, 200, 20);
+    attackSlider.setBounds(100, 80, 200, 20);
+    decaySlider.setBounds(100, 110, 200, 20);
+    sustainSlider.setBounds(100, 140, 200, 20);
+    releaseSlider.setBounds(100, 170, 200, 20);
+    cullFloorSlider.setBounds(100, 200, 200, 20);
+    voiceStealingBox.setBounds(100, 230, 130, 20);
+    polyphonySlider.setBounds(290, 230, 100, 20);
+    multiTimbralButton.setBounds(20, 256, 360, 22);
+    loadGovernorButton.setBounds(20, 278, 360, 22);
+    waveformInstructionsLabel.setBounds(10, 300, 380, 18);
+    keyboard.setBounds(10, 320, 380, 56);
+   #if HW4_TRACING
+    midiInputBox.setBounds(100, 382, 130, 20);
+    traceButton.setBounds(240, 382, 50, 20);
+   #else
+    midiInputBox.setBounds(100, 382, 190, 20);
+   #endif
+    panicButton.setBounds(300, 382, 90, 20);
+    performanceLabel.setBounds(10, 406, 380, 34);
+    analyserView.setBounds(10, 444, 380, 210);
 
 }
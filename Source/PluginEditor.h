@@ -11,12 +11,15 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "MIDISynth.h"
+#include "AnalyserView.h"
+#include "TraceRecorder.h"
 
 //==============================================================================
 /**
 */
 class Hw4AudioProcessorEditor  : public juce::AudioProcessorEditor,
-                                 public juce::Slider::Listener
+                                 private juce::Timer,
+                                 private juce::MidiKeyboardState::Listener
 {
 public:
     Hw4AudioProcessorEditor (Hw4AudioProcessor&);
@@ -25,19 +28,72 @@ public:
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
-    
-    void sliderValueChanged(juce::Slider* slider) override;
 
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     Hw4AudioProcessor& audioProcessor;
     
+    using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
+    using ComboBoxAttachment = juce::AudioProcessorValueTreeState::ComboBoxAttachment;
+    using ButtonAttachment = juce::AudioProcessorValueTreeState::ButtonAttachment;
+
     juce::Slider masterGainSlider;
     juce::Label masterGainLabel;
+
+    juce::ComboBox waveTypeBox;
+    juce::Label waveTypeLabel;
+
+    juce::ComboBox voiceStealingBox;
+    juce::Label voiceStealingLabel;
+
+    juce::Slider polyphonySlider, renderThreadsSlider;
+    juce::Label polyphonyLabel, renderThreadsLabel;
+
+    juce::ToggleButton multiTimbralButton { "Multi-Timbral (program change picks each channel's wave)" };
+    juce::ToggleButton loadGovernorButton { "Load Governor (sheds voices and quality under CPU load)" };
+
+    juce::Slider attackSlider, decaySlider, sustainSlider, releaseSlider, cullFloorSlider;
+    juce::Label attackLabel, decayLabel, sustainLabel, releaseLabel, cullFloorLabel;
     
     juce::Label waveformInstructionsLabel;
 
+    // Played straight into the synth through the processor's injection queue, never through a lock
+    juce::MidiKeyboardState keyboardState;
+    juce::MidiKeyboardComponent keyboard { keyboardState, juce::MidiKeyboardComponent::horizontalKeyboard };
+
+    juce::ComboBox midiInputBox;
+    juce::Label midiInputLabel;
+    juce::Array<juce::MidiDeviceInfo> midiInputDevices;
+    juce::TextButton panicButton { "Panic" };
+
+   #if HW4_TRACING
+    // Records a Chrome trace of every instance in the process to a file in Documents
+    juce::TextButton traceButton { "Trace" };
+    juce::File traceFile;
+   #endif
+
+    // Live CPU load, refreshed by the timer rather than per block
+    juce::Label performanceLabel;
+    PerformanceMonitor::Reader performanceReader;
+
+    // Scope and spectrum of the output, with its own refresh timer
+    AnalyserView analyserView;
+
+    // Attachments keep the controls and the host-automatable parameters in sync;
+    // declared last so they are destroyed before the controls
+    std::unique_ptr<SliderAttachment> masterGainAttachment, attackAttachment, decayAttachment, sustainAttachment,
+                                      releaseAttachment, cullFloorAttachment, polyphonyAttachment,
+                                      renderThreadsAttachment;
+    std::unique_ptr<ComboBoxAttachment> waveTypeAttachment, voiceStealingAttachment;
+    std::unique_ptr<ButtonAttachment> multiTimbralAttachment, loadGovernorAttachment;
+
+    void addLabelledSlider(juce::Slider& slider, juce::Label& label, const juce::String& name);
+    void timerCallback() override;
+    void handleNoteOn(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
+    void handleNoteOff(juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override;
+    void updateMidiInputs();
+
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Hw4AudioProcessorEditor)
 };
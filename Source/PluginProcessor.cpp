@@ -8,24 +8,162 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "TraceRecorder.h"
+
+namespace
+{
+    // The parameter behind each SynthPatch value, in the same order
+    const std::array<const juce::ParameterID*, SynthPatch::numValues> patchValueIDs
+    {
+        &ParameterIDs::masterGain, &ParameterIDs::waveType, &ParameterIDs::attack, &ParameterIDs::decay,
+        &ParameterIDs::sustain, &ParameterIDs::release, &ParameterIDs::cullFloor, &ParameterIDs::voiceStealing,
+        &ParameterIDs::polyphony, &ParameterIDs::renderThreads, &ParameterIDs::multiTimbral,
+        &ParameterIDs::loadGovernor
+    };
+
+    // Negative entries, and anything a program doesn't list, keep the parameter's default
+    struct FactoryProgram
+    {
+        const char* name;
+        float waveType, attack, decay, sustain, release;
+    };
+
+    const FactoryProgram factoryPrograms[]
+    {
+        { "Init",     -1.0f,          -1.0f,  -1.0f,  -1.0f,  -1.0f },
+        { "Soft Pad", Tone::Sine,     400.0f, 800.0f, 70.0f,  1200.0f },
+        { "Pluck",    Tone::Sawtooth, 1.0f,   250.0f, 0.0f,   150.0f },
+        { "Organ",    Tone::Square,   2.0f,   100.0f, 100.0f, 20.0f },
+        { "Saw Lead", Tone::Sawtooth, 5.0f,   300.0f, 60.0f,  80.0f }
+    };
+
+    constexpr int numFactoryPrograms = static_cast<int> (std::size (factoryPrograms));
+}
 
 //==============================================================================
 Hw4AudioProcessor::Hw4AudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
+     : AudioProcessor (createBusesProperties()),
+#else
+     :
+#endif
+       parameters (*this, nullptr, "PARAMETERS", createParameterLayout())
+{
+    masterGainParameter = parameters.getRawParameterValue (ParameterIDs::masterGain.getParamID());
+    waveTypeParameter = parameters.getRawParameterValue (ParameterIDs::waveType.getParamID());
+    attackParameter = parameters.getRawParameterValue (ParameterIDs::attack.getParamID());
+    decayParameter = parameters.getRawParameterValue (ParameterIDs::decay.getParamID());
+    sustainParameter = parameters.getRawParameterValue (ParameterIDs::sustain.getParamID());
+    releaseParameter = parameters.getRawParameterValue (ParameterIDs::release.getParamID());
+    cullFloorParameter = parameters.getRawParameterValue (ParameterIDs::cullFloor.getParamID());
+    voiceStealingParameter = parameters.getRawParameterValue (ParameterIDs::voiceStealing.getParamID());
+    polyphonyParameter = parameters.getRawParameterValue (ParameterIDs::polyphony.getParamID());
+    multiTimbralParameter = parameters.getRawParameterValue (ParameterIDs::multiTimbral.getParamID());
+    loadGovernorParameter = parameters.getRawParameterValue (ParameterIDs::loadGovernor.getParamID());
+    renderThreadsParameter = parameters.getRawParameterValue (ParameterIDs::renderThreads.getParamID());
+
+    parameters.addParameterListener (ParameterIDs::polyphony.getParamID(), this);
+    parameters.addParameterListener (ParameterIDs::renderThreads.getParamID(), this);
+}
+
+Hw4AudioProcessor::~Hw4AudioProcessor()
+{
+    parameters.removeParameterListener (ParameterIDs::polyphony.getParamID(), this);
+    parameters.removeParameterListener (ParameterIDs::renderThreads.getParamID(), this);
+    cancelPendingUpdate();
+
+    // Stop the device's callbacks before anything they push to goes away
+    midiInputDevice.reset();
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout Hw4AudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    const EnvelopeParameters defaultEnvelope;
+
+    // The original master gain slider's range and feel, scaled up by 127 now that velocities are 0-1
+    juce::NormalisableRange<float> gainRange (0.0127f, 0.127f, 0.00127f);
+    gainRange.setSkewForCentre (0.06985f);
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        ParameterIDs::masterGain, "Master Gain", gainRange, ToneBank::defaultMasterGain,
+        juce::AudioParameterFloatAttributes().withStringFromValueFunction ([] (float value, int)
+        {
+            return juce::String (value, 6);
+        })));
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (
+        ParameterIDs::waveType, "Wave Type", juce::StringArray { "Sine", "Square", "Sawtooth" }, 0));
+
+    juce::NormalisableRange<float> attackRange (0.5f, 2000.0f, 0.1f);
+    attackRange.setSkewForCentre (50.0f);
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        ParameterIDs::attack, "Attack", attackRange, static_cast<float> (defaultEnvelope.attackMilliseconds),
+        juce::AudioParameterFloatAttributes().withLabel ("ms")));
+
+    juce::NormalisableRange<float> decayRange (1.0f, 5000.0f, 0.1f);
+    decayRange.setSkewForCentre (200.0f);
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        ParameterIDs::decay, "Decay", decayRange, static_cast<float> (defaultEnvelope.decayMilliseconds),
+        juce::AudioParameterFloatAttributes().withLabel ("ms")));
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        ParameterIDs::sustain, "Sustain", juce::NormalisableRange<float> (0.0f, 100.0f, 0.1f),
+        static_cast<float> (defaultEnvelope.sustainLevel * 100.0), juce::AudioParameterFloatAttributes().withLabel ("%")));
+
+    juce::NormalisableRange<float> releaseRange (0.5f, 5000.0f, 0.1f);
+    releaseRange.setSkewForCentre (100.0f);
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        ParameterIDs::release, "Release", releaseRange, static_cast<float> (defaultEnvelope.releaseMilliseconds),
+        juce::AudioParameterFloatAttributes().withLabel ("ms")));
+
+    // Released tones stop rendering once they have fallen this far below their peak
+    layout.add (std::make_unique<juce::AudioParameterFloat> (
+        ParameterIDs::cullFloor, "Cull Floor", juce::NormalisableRange<float> (-120.0f, -40.0f, 1.0f),
+        static_cast<float> (defaultEnvelope.cullDecibels), juce::AudioParameterFloatAttributes().withLabel ("dB")));
+
+    // Order matches ToneBank::StealingPolicy
+    layout.add (std::make_unique<juce::AudioParameterChoice> (
+        ParameterIDs::voiceStealing, "Voice Stealing", juce::StringArray { "Oldest", "Quietest", "Released First", "Same Note" }, 0));
+
+    // Sizes the voice pool, so a change re-prepares the synth rather than following automation
+    layout.add (std::make_unique<juce::AudioParameterInt> (
+        ParameterIDs::polyphony, "Polyphony", 1, maxPolyphony, defaultPolyphony,
+        juce::AudioParameterIntAttributes().withAutomatable (false)));
+
+    // Each MIDI channel becomes its own part, with its own wave type, volume and output
+    layout.add (std::make_unique<juce::AudioParameterBool> (ParameterIDs::multiTimbral, "Multi-Timbral", false));
+
+    // Trades voices and oscillator quality for headroom when the CPU can't keep up
+    layout.add (std::make_unique<juce::AudioParameterBool> (ParameterIDs::loadGovernor, "Load Governor", true));
+
+    // Off by default: the host may already be spreading plugins across every core
+    layout.add (std::make_unique<juce::AudioParameterInt> (
+        ParameterIDs::renderThreads, "Render Threads", 0, maxRenderThreads, 0,
+        juce::AudioParameterIntAttributes().withAutomatable (false)));
+
+    return layout;
+}
+
+juce::AudioProcessor::BusesProperties Hw4AudioProcessor::createBusesProperties()
+{
+    auto properties = BusesProperties()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
-                       )
-#endif
-{
-}
+                       ;
 
-Hw4AudioProcessor::~Hw4AudioProcessor()
-{
+   #if ! JucePlugin_IsMidiEffect
+    // Optional outputs for multi-timbral parts 2-16, off until the host enables them;
+    // part 1, and any part whose output is off, plays through the main output
+    for (int part = 2; part <= ToneBank::maxOutputBuses; ++part)
+        properties = properties.withOutput ("Part " + juce::String (part), juce::AudioChannelSet::stereo(), false);
+   #endif
+
+    return properties;
 }
 
 //==============================================================================
@@ -68,22 +206,45 @@ double Hw4AudioProcessor::getTailLengthSeconds() const
 
 int Hw4AudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return numFactoryPrograms;
 }
 
 int Hw4AudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
 void Hw4AudioProcessor::setCurrentProgram (int index)
 {
+    if (! juce::isPositiveAndBelow (index, numFactoryPrograms))
+        return;
+
+    const auto& program = factoryPrograms[index];
+    auto values = getDefaultValues();
+
+    const std::pair<SynthPatch::Value, float> programValues[]
+    {
+        { SynthPatch::waveType, program.waveType }, { SynthPatch::attack, program.attack }, { SynthPatch::decay, program.decay },
+        { SynthPatch::sustain, program.sustain }, { SynthPatch::release, program.release }
+    };
+
+    for (const auto& [value, programValue] : programValues)
+        if (programValue >= 0.0f)
+            values[value] = programValue;
+
+    // A program is a sound; it leaves the multi-timbral setup, the governor and the voice and thread counts alone
+    values[SynthPatch::multiTimbral] = multiTimbralParameter->load();
+    values[SynthPatch::loadGovernor] = loadGovernorParameter->load();
+    values[SynthPatch::polyphony] = polyphonyParameter->load();
+    values[SynthPatch::renderThreads] = renderThreadsParameter->load();
+
+    currentProgram.store (index);
+    loadPatch (values);
 }
 
 const juce::String Hw4AudioProcessor::getProgramName (int index)
 {
-    return {};
+    return juce::isPositiveAndBelow (index, numFactoryPrograms) ? factoryPrograms[index].name : juce::String();
 }
 
 void Hw4AudioProcessor::changeProgramName (int index, const juce::String& newName)
@@ -93,7 +254,33 @@ void Hw4AudioProcessor::changeProgramName (int index, const juce::String& newNam
 //==============================================================================
 void Hw4AudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    toneBank.prepareToPlay(sampleRate);
+    // The output buffer holds every enabled bus back to back
+    std::array<int, ToneBank::maxOutputBuses> busChannels {};
+    const int numBuses = juce::jmin (getBusCount (false), ToneBank::maxOutputBuses);
+
+    for (int bus = 0; bus < numBuses; ++bus)
+        busChannels[(size_t) bus] = getChannelCountOfBus (false, bus);
+
+    toneBank.setOutputBuses (busChannels.data(), numBuses);
+
+    // Apply the parameters first so preparing snaps the gain to them instead of ramping
+    lastWaveTypeChoice = -1;
+    lastMultiTimbral = -1;
+    applyParameters();
+
+    toneBank.setPolyphony (juce::roundToInt (polyphonyParameter->load()));
+    toneBank.prepareToPlay(sampleRate, samplesPerBlock);
+
+    // Workers only join in once a block has enough voices to be worth splitting
+    const int renderThreads = juce::roundToInt (renderThreadsParameter->load());
+
+    if (renderThreads != toneBank.getNumParallelWorkers())
+        toneBank.setParallelRendering (renderThreads, 2 * ToneBank::parallelVoicesPerChunk);
+
+    performanceMonitor.prepare(sampleRate);
+    loadGovernor.prepare(sampleRate);
+    midiInjectionQueue.prepare(sampleRate);
+    outputAnalyser.prepare(sampleRate);
 }
 
 void Hw4AudioProcessor::releaseResources()
@@ -102,6 +289,12 @@ void Hw4AudioProcessor::releaseResources()
     // spare memory, etc.
 }
 
+void Hw4AudioProcessor::reset()
+{
+    // Hosts call this between renders and on transport jumps, never during processBlock
+    toneBank.allSoundOff();
+}
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool Hw4AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
@@ -117,6 +310,15 @@ bool Hw4AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) cons
      && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
 
+    // Part outputs can be off, mono or stereo
+    for (int bus = 1; bus < layouts.outputBuses.size(); ++bus)
+    {
+        const auto& set = layouts.outputBuses.getReference (bus);
+
+        if (! set.isDisabled() && set != juce::AudioChannelSet::mono() && set != juce::AudioChannelSet::stereo())
+            return false;
+    }
+
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
@@ -129,50 +331,302 @@ bool Hw4AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) cons
 #endif
 
 void Hw4AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples (buffer, midiMessages);
+}
+
+void Hw4AudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples (buffer, midiMessages);
+}
+
+template <typename SampleType>
+void Hw4AudioProcessor::processSamples (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    HW4_TRACE_SCOPE (processBlock, buffer.getNumSamples(), toneBank.getNumActiveVoices());
 
-       // Clear the buffer before rendering
-       buffer.clear();
+       const auto blockStart = PerformanceMonitor::now();
+       juce::int64 renderTicks = 0;
 
-       for (const auto metadata : midiMessages)
+       // Channels that only exist on the input side aren't ours to fill
+       for (auto i = getTotalNumOutputChannels(); i < getTotalNumInputChannels(); ++i)
+           buffer.clear (i, 0, buffer.getNumSamples());
+
+       // Times each render call so the monitor can split synthesis from the rest of the block.
+       // ToneBank writes each bus prepareToPlay declared, mono or stereo, and silences any channel
+       // past them, so it renders straight into the host's buffer; a referencing AudioBuffer view
+       // would heap-allocate its channel list every block once the part outputs take it to 32.
+       auto renderRange = [&] (int startSample, int numSamplesToRender)
        {
-           const juce::MidiMessage& m = metadata.getMessage();
-           if (m.isNoteOn())
-           {
-               float frequency = juce::MidiMessage::getMidiNoteInHertz(m.getNoteNumber());
-               float velocity = m.getFloatVelocity() * 127.0f; // Ensure velocity is in 0-127 range
-
-               // Check if the MIDI note is one of the special triggering notes
-               // Example: Low C (48), D (50), E (52)
-               if (m.getNoteNumber() == 48 || m.getNoteNumber() == 50 || m.getNoteNumber() == 52)
-               {
-                   // Set the wave type in ToneBank based on the special note
-                   Tone::WaveType newWaveType = Tone::Sine;
-                   if (m.getNoteNumber() == 48)
-                       newWaveType = Tone::Sine;
-                   else if (m.getNoteNumber() == 50)
-                       newWaveType = Tone::Square;
-                   else if (m.getNoteNumber() == 52)
-                       newWaveType = Tone::Sawtooth;
-
-                   toneBank.setWaveType(newWaveType);
-               }
-               else
-               {
-                   // Regular note-on event
-                   toneBank.noteOn(frequency, velocity, toneBank.getCurrentWaveType());
-               }
-           }
-           else if (m.isNoteOff())
+           const auto renderStart = PerformanceMonitor::now();
+           toneBank.renderBuffer(buffer, startSample, numSamplesToRender);
+           renderTicks += PerformanceMonitor::now() - renderStart;
+       };
+
+       // Pick up parameter changes; these are lock-free atomic reads
+       applyParameters();
+
+       const int numSamples = buffer.getNumSamples();
+       int renderedUpTo = 0;
+
+       // The editor's and the MIDI input's events, already ordered and placed in this block
+       const int numInjectedEvents = midiInjectionQueue.collectBlock(numSamples);
+       int injectedEvent = 0;
+       auto hostEvent = midiMessages.cbegin();
+
+       // Render up to each event, then apply it, so every event lands on its exact sample. Host and
+       // injected events are merged by position; at the same sample the host's go first.
+       while (hostEvent != midiMessages.cend() || injectedEvent < numInjectedEvents)
+       {
+           const bool fromHost = injectedEvent == numInjectedEvents
+                                 || (hostEvent != midiMessages.cend()
+                                     && (*hostEvent).samplePosition <= midiInjectionQueue.getEvent(injectedEvent).samplePosition);
+
+           const int eventPosition = juce::jlimit(0, numSamples, fromHost ? (*hostEvent).samplePosition
+                                                                          : midiInjectionQueue.getEvent(injectedEvent).samplePosition);
+
+           if (eventPosition > renderedUpTo)
            {
-               float frequency = juce::MidiMessage::getMidiNoteInHertz(m.getNoteNumber());
-               toneBank.noteOff(frequency);
+               renderRange(renderedUpTo, eventPosition - renderedUpTo);
+               renderedUpTo = eventPosition;
            }
+
+           if (fromHost)
+               handleMidiMessage((*hostEvent++).getMessage());
+           else
+               handleMidiMessage(midiInjectionQueue.getEvent(injectedEvent++).message);
        }
 
-       // Render the audio buffer from ToneBank
-       toneBank.renderBuffer(buffer);
+       // Render the rest of the block from ToneBank
+       if (renderedUpTo < numSamples)
+           renderRange(renderedUpTo, numSamples - renderedUpTo);
+
+       // Wait-free; does nothing unless the editor's analyser is open
+       outputAnalyser.pushBlock(buffer, toneBank.getNumActiveVoices());
+
+       const auto load = performanceMonitor.recordBlock(numSamples, PerformanceMonitor::now() - blockStart, renderTicks, toneBank.getNumActiveVoices());
+
+       // Offline renders have no deadline to protect, so they always get full quality
+       loadGovernor.setEnabled(loadGovernorEnabled && ! isNonRealtime());
+       loadGovernor.update(numSamples, load);
+}
+
+void Hw4AudioProcessor::applyParameters()
+{
+    // A recalled preset arrives with its coefficients already worked out
+    if (auto* patch = patchExchange.take())
+    {
+        applyValues (patch->getValues(), patch);
+        patchExchange.retire (patch);
+    }
+
+    // Leave the parameters alone while a preset load is rewriting them, so it never lands half-way
+    const auto sequence = parameterLoadSequence.load (std::memory_order_acquire);
+
+    if ((sequence & 1) != 0)
+        return;
+
+    const auto values = readParameterValues();
+
+    std::atomic_thread_fence (std::memory_order_acquire);
+
+    if (parameterLoadSequence.load (std::memory_order_relaxed) != sequence)
+        return;
+
+    // These are lock-free atomic reads, and unchanged values cost nothing to apply
+    applyValues (values, nullptr);
+}
+
+void Hw4AudioProcessor::applyValues (const SynthPatch::Values& values, const SynthPatch* preparedPatch)
+{
+    toneBank.setMasterGain (values[SynthPatch::masterGain]);
+
+    if (preparedPatch != nullptr && preparedPatch->getSampleRate() == toneBank.getSampleRate())
+        toneBank.setEnvelope (preparedPatch->getEnvelopeParameters(), preparedPatch->getEnvelopeCoefficients());
+    else
+        toneBank.setEnvelope (SynthPatch::envelopeParametersFor (values));
+
+    toneBank.setStealingPolicy (static_cast<ToneBank::StealingPolicy> (static_cast<int> (values[SynthPatch::voiceStealing])));
+
+    // Only forward wave type changes, so the C3/D3/E3 note switches keep working in between
+    const int waveTypeChoice = static_cast<int> (values[SynthPatch::waveType]);
+
+    if (waveTypeChoice != lastWaveTypeChoice)
+    {
+        toneBank.setWaveType (static_cast<Tone::WaveType> (waveTypeChoice));
+        lastWaveTypeChoice = waveTypeChoice;
+    }
+
+    const int multiTimbral = values[SynthPatch::multiTimbral] >= 0.5f ? 1 : 0;
+
+    if (multiTimbral != lastMultiTimbral)
+    {
+        routeChannels (multiTimbral == 1);
+        lastMultiTimbral = multiTimbral;
+    }
+
+    loadGovernorEnabled = values[SynthPatch::loadGovernor] >= 0.5f;
+}
+
+void Hw4AudioProcessor::routeChannels (bool multiTimbral)
+{
+    // Channel n plays through part output n - 1; ToneBank falls back to the main output for parts the host hasn't enabled
+    for (int channel = 1; channel <= ToneBank::numMidiChannels; ++channel)
+        toneBank.setChannelOutputBus (channel, multiTimbral ? channel - 1 : 0);
+}
+
+SynthPatch::Values Hw4AudioProcessor::readParameterValues() const
+{
+    SynthPatch::Values values;
+    values[SynthPatch::masterGain] = masterGainParameter->load();
+    values[SynthPatch::waveType] = waveTypeParameter->load();
+    values[SynthPatch::attack] = attackParameter->load();
+    values[SynthPatch::decay] = decayParameter->load();
+    values[SynthPatch::sustain] = sustainParameter->load();
+    values[SynthPatch::release] = releaseParameter->load();
+    values[SynthPatch::cullFloor] = cullFloorParameter->load();
+    values[SynthPatch::voiceStealing] = voiceStealingParameter->load();
+    values[SynthPatch::polyphony] = polyphonyParameter->load();
+    values[SynthPatch::renderThreads] = renderThreadsParameter->load();
+    values[SynthPatch::multiTimbral] = multiTimbralParameter->load();
+    values[SynthPatch::loadGovernor] = loadGovernorParameter->load();
+    return values;
+}
+
+SynthPatch::Values Hw4AudioProcessor::getDefaultValues() const
+{
+    SynthPatch::Values values;
+
+    for (size_t i = 0; i < patchValueIDs.size(); ++i)
+    {
+        auto* parameter = parameters.getParameter (patchValueIDs[i]->getParamID());
+        values[i] = parameter->convertFrom0to1 (parameter->getDefaultValue());
+    }
+
+    return values;
+}
+
+void Hw4AudioProcessor::loadPatch (const SynthPatch::Values& values)
+{
+    // Message thread only. Rewrite the parameters so the host and editor follow, then publish a
+    // prepared patch built from what they snapped to; the audio thread swaps it in at its next block.
+    parameterLoadSequence.fetch_add (1, std::memory_order_acq_rel);
+
+    for (size_t i = 0; i < patchValueIDs.size(); ++i)
+    {
+        auto* parameter = parameters.getParameter (patchValueIDs[i]->getParamID());
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (values[i]));
+    }
+
+    auto patch = std::make_unique<SynthPatch> (readParameterValues());
+    patch->prepare (getSampleRate() > 0.0 ? getSampleRate() : 44100.0);
+    patchExchange.publish (std::move (patch));
+
+    parameterLoadSequence.fetch_add (1, std::memory_order_acq_rel);
+}
+
+void Hw4AudioProcessor::handleMidiMessage (const juce::MidiMessage& m)
+{
+    // Multi-timbral parts take their wave type from program changes, and play every note
+    const bool multiTimbral = lastMultiTimbral == 1;
+
+    if (m.isNoteOn())
+    {
+        const float velocity = m.getFloatVelocity();
+
+        // Check if the MIDI note is one of the special triggering notes
+        // Example: Low C (48), D (50), E (52)
+        if (! multiTimbral && (m.getNoteNumber() == 48 || m.getNoteNumber() == 50 || m.getNoteNumber() == 52))
+        {
+            // Set the wave type in ToneBank based on the special note
+            Tone::WaveType newWaveType = Tone::Sine;
+            if (m.getNoteNumber() == 48)
+                newWaveType = Tone::Sine;
+            else if (m.getNoteNumber() == 50)
+                newWaveType = Tone::Square;
+            else if (m.getNoteNumber() == 52)
+                newWaveType = Tone::Sawtooth;
+
+            toneBank.setWaveType(newWaveType);
+        }
+        else
+        {
+            // Regular note-on event
+            const auto waveType = multiTimbral ? toneBank.getChannelWaveType (m.getChannel()) : toneBank.getCurrentWaveType();
+            toneBank.noteOn(m.getChannel(), m.getNoteNumber(), velocity, waveType);
+        }
+    }
+    else if (m.isNoteOff())
+    {
+        toneBank.noteOff(m.getChannel(), m.getNoteNumber());
+    }
+    else if (m.isControllerOfType (10))
+    {
+        // Pan: 0 is hard left, 64 centre, 127 hard right
+        toneBank.setChannelPan (m.getChannel(), juce::jlimit (-1.0f, 1.0f, (m.getControllerValue() - 64) / 63.0f));
+    }
+    else if (m.isControllerOfType (7))
+    {
+        // Channel volume, on the usual squared curve
+        toneBank.setChannelGain (m.getChannel(), juce::square (m.getControllerValue() / 127.0f));
+    }
+    else if (m.isAllSoundOff())
+    {
+        toneBank.allSoundOff();
+    }
+    else if (m.isResetAllControllers())
+    {
+        toneBank.resetChannelControllers (m.getChannel());
+    }
+    else if (m.isProgramChange() && multiTimbral)
+    {
+        // Programs cycle through the wave types: 0 sine, 1 square, 2 sawtooth, 3 sine...
+        toneBank.setChannelWaveType (m.getChannel(), static_cast<Tone::WaveType> (m.getProgramChangeNumber() % Tone::numWaveTypes));
+    }
+}
+
+bool Hw4AudioProcessor::setMidiInputDevice (const juce::String& identifier)
+{
+    midiInputDevice.reset();
+
+    if (identifier.isEmpty())
+        return true;
+
+    midiInputDevice = juce::MidiInput::openDevice (identifier, this);
+
+    if (midiInputDevice == nullptr)
+        return false;
+
+    midiInputDevice->start();
+    return true;
+}
+
+void Hw4AudioProcessor::handleIncomingMidiMessage (juce::MidiInput*, const juce::MidiMessage& message)
+{
+    // The device's own thread; MidiInput stamps messages on the same clock the queue uses
+    midiInjectionQueue.push (MidiInjectionQueue::midiInput, message, message.getTimeStamp());
+}
+
+void Hw4AudioProcessor::parameterChanged (const juce::String& parameterID, float)
+{
+    // Whichever thread changed them, the voice pool and the workers are only ever rebuilt on the message thread
+    if (parameterID == ParameterIDs::polyphony.getParamID() || parameterID == ParameterIDs::renderThreads.getParamID())
+        triggerAsyncUpdate();
+}
+
+void Hw4AudioProcessor::handleAsyncUpdate()
+{
+    // Nothing to resize until the host has prepared us, and prepareToPlay will pick the counts up then
+    if (getSampleRate() <= 0.0
+        || (juce::roundToInt (polyphonyParameter->load()) == toneBank.getPolyphony()
+            && juce::roundToInt (renderThreadsParameter->load()) == toneBank.getNumParallelWorkers()))
+        return;
+
+    // Suspending holds processBlock off while the pool and workers are rebuilt; sounding notes are dropped
+    suspendProcessing (true);
+    prepareToPlay (getSampleRate(), getBlockSize());
+    suspendProcessing (false);
 }
 
 //==============================================================================
@@ -189,15 +643,40 @@ juce::AudioProcessorEditor* Hw4AudioProcessor::createEditor()
 //==============================================================================
 void Hw4AudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    juce::MemoryOutputStream stream (destData, false);
+    SynthPatch::writeState (stream, readParameterValues(), currentProgram.load());
 }
 
 void Hw4AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    // Values the state doesn't mention keep their defaults
+    auto values = getDefaultValues();
+    int program = currentProgram.load();
+
+    if (! SynthPatch::readState (data, (size_t) juce::jmax (0, sizeInBytes), values, program))
+    {
+        // Fall back to a parameter tree saved as XML
+        const auto xml = getXmlFromBinary (data, sizeInBytes);
+
+        if (xml == nullptr)
+            return;
+
+        const auto tree = juce::ValueTree::fromXml (*xml);
+
+        if (! tree.hasType (parameters.state.getType()))
+            return;
+
+        for (size_t i = 0; i < patchValueIDs.size(); ++i)
+        {
+            const auto child = tree.getChildWithProperty ("id", patchValueIDs[i]->getParamID());
+
+            if (child.isValid() && child.hasProperty ("value"))
+                values[i] = static_cast<float> (child["value"]);
+        }
+    }
+
+    currentProgram.store (juce::jlimit (0, numFactoryPrograms - 1, program));
+    loadPatch (values);
 }
 
 //==============================================================================
@@ -10,11 +10,35 @@
 
 #include <JuceHeader.h>
 #include "MIDISynth.h"
+#include "PerformanceMonitor.h"
+#include "LoadGovernor.h"
+#include "OutputAnalyser.h"
+#include "MidiInjectionQueue.h"
+#include "SynthPatch.h"
+
+namespace ParameterIDs
+{
+    const juce::ParameterID masterGain  { "masterGain", 1 };
+    const juce::ParameterID waveType    { "waveType", 1 };
+    const juce::ParameterID attack      { "attack", 1 };
+    const juce::ParameterID decay       { "decay", 1 };
+    const juce::ParameterID sustain     { "sustain", 1 };
+    const juce::ParameterID release     { "release", 1 };
+    const juce::ParameterID cullFloor   { "cullFloor", 1 };
+    const juce::ParameterID voiceStealing { "voiceStealing", 1 };
+    const juce::ParameterID polyphony { "polyphony", 1 };
+    const juce::ParameterID multiTimbral { "multiTimbral", 1 };
+    const juce::ParameterID loadGovernor { "loadGovernor", 1 };
+    const juce::ParameterID renderThreads { "renderThreads", 1 };
+}
 
 //==============================================================================
 /**
 */
-class Hw4AudioProcessor  : public juce::AudioProcessor
+class Hw4AudioProcessor  : public juce::AudioProcessor,
+                           private juce::MidiInputCallback,
+                           private juce::AudioProcessorValueTreeState::Listener,
+                           private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -24,12 +48,17 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // Hosts that run at 64 bits get ToneBank's double path instead of a float conversion
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -55,8 +84,73 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
     
     ToneBank& getToneBank() { return toneBank; }
+    juce::AudioProcessorValueTreeState& getParameters() { return parameters; }
+    const PerformanceMonitor& getPerformanceMonitor() const { return performanceMonitor; }
+    const LoadGovernor& getLoadGovernor() const { return loadGovernor; }
+    OutputAnalyser& getOutputAnalyser() { return outputAnalyser; }
+    // Notes from the editor and other non-host sources; pushing never blocks
+    MidiInjectionQueue& getMidiInjectionQueue() { return midiInjectionQueue; }
+
+    // Message thread. Plays a local MIDI input device alongside the host's MIDI; an empty identifier closes it.
+    bool setMidiInputDevice (const juce::String& identifier);
+    juce::String getMidiInputDevice() const { return midiInputDevice != nullptr ? midiInputDevice->getIdentifier() : juce::String(); }
+
+    // Prepare-time settings, so hosts can't automate them: the voices the pool is sized for,
+    // and the extra threads that share the voices of a block once there are enough of them
+    static constexpr int defaultPolyphony = 32;
+    static constexpr int maxPolyphony = ToneBank::maxPolyphony;
+    static constexpr int maxRenderThreads = 8;
+
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    static BusesProperties createBusesProperties();
 
 private:
     ToneBank toneBank;
+    juce::AudioProcessorValueTreeState parameters;
+    PerformanceMonitor performanceMonitor;
+    LoadGovernor loadGovernor { toneBank };
+    OutputAnalyser outputAnalyser;
+    MidiInjectionQueue midiInjectionQueue;
+    std::unique_ptr<juce::MidiInput> midiInputDevice;
+
+    // Recalled presets and programs reach the audio thread through here, already prepared
+    PatchExchange patchExchange;
+    // Odd while loadPatch() is rewriting the parameters, so the audio thread never reads a half-loaded preset
+    std::atomic<juce::uint32> parameterLoadSequence { 0 };
+    std::atomic<int> currentProgram { 0 };
+
+    // Atomic parameter storage, read once per block on the audio thread
+    std::atomic<float>* masterGainParameter = nullptr;
+    std::atomic<float>* waveTypeParameter = nullptr;
+    std::atomic<float>* attackParameter = nullptr;
+    std::atomic<float>* decayParameter = nullptr;
+    std::atomic<float>* sustainParameter = nullptr;
+    std::atomic<float>* releaseParameter = nullptr;
+    std::atomic<float>* cullFloorParameter = nullptr;
+    std::atomic<float>* voiceStealingParameter = nullptr;
+    std::atomic<float>* polyphonyParameter = nullptr;
+    std::atomic<float>* multiTimbralParameter = nullptr;
+    std::atomic<float>* loadGovernorParameter = nullptr;
+    std::atomic<float>* renderThreadsParameter = nullptr;
+    int lastWaveTypeChoice = -1;
+    int lastMultiTimbral = -1;
+    bool loadGovernorEnabled = true;
+
+    void applyParameters();
+    void applyValues (const SynthPatch::Values& values, const SynthPatch* preparedPatch);
+    SynthPatch::Values readParameterValues() const;
+    SynthPatch::Values getDefaultValues() const;
+    void loadPatch (const SynthPatch::Values& values);
+    void routeChannels (bool multiTimbral);
+
+    template <typename SampleType>
+    void processSamples (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages);
+
+    void handleMidiMessage (const juce::MidiMessage& m);
+    void handleIncomingMidiMessage (juce::MidiInput* source, const juce::MidiMessage& message) override;
+
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Hw4AudioProcessor)
 };
@@ -0,0 +1,572 @@
+/*
+  ==============================================================================
+
+    SIMDToneEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "SIMDToneEngine.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+
+ // GCC and Clang need the ISA enabled per function so the runtime-selected
+ // kernels can live in one translation unit built for the baseline target
+ #if JUCE_GCC || JUCE_CLANG
+  #define HW4_TARGET(isa) __attribute__((target (isa)))
+ #else
+  #define HW4_TARGET(isa)
+ #endif
+#endif
+
+namespace
+{
+    enum { sineWave, squareWave, sawtoothWave };
+
+    // sin (2 pi p) == sin (pi t) with t = 1 - 2p in (-1, 1], approximated by
+    // t (1 - t^2) P (t^2). Max absolute error is 1.1e-7, below float resolution.
+    constexpr float sineC0 = 3.14159129794f;
+    constexpr float sineC1 = -2.02608378957f;
+    constexpr float sineC2 = 0.52378047779f;
+    constexpr float sineC3 = -0.07445941221f;
+    constexpr float sineC4 = 0.00597331655f;
+
+    // Phases are converted through their top 24 bits, which is exact in float
+    constexpr float phaseScale = 1.0f / 16777216.0f;
+
+    using Phase = PhaseAccumulator::Phase;
+
+    using Kernel = void (*)(Phase* phase, const Phase* phaseIncrement, float* gain,
+                            const float* envelopeMultiplier, const float* envelopeOffset,
+                            const float* panLeft, const float* panRight,
+                            int numLanes, float* outLeft, float* outRight, int numSamples);
+
+    //==============================================================================
+    template <int waveType>
+    inline float waveSample(Phase phase) {
+        if constexpr (waveType == sineWave) {
+            const float t = 1.0f - 2.0f * PhaseAccumulator::toFloat(phase);
+            const float t2 = t * t;
+            return t * (1.0f - t2) * (sineC0 + t2 * (sineC1 + t2 * (sineC2 + t2 * (sineC3 + t2 * sineC4))));
+        } else if constexpr (waveType == squareWave) {
+            return phase < PhaseAccumulator::halfCycle ? 1.0f : -1.0f;
+        } else {
+            return 2.0f * PhaseAccumulator::toFloat(phase) - 1.0f;
+        }
+    }
+
+    // Plain C++ kernel; the fixed-width inner loop leaves the compiler free to
+    // vectorise it for whatever the target supports (e.g. NEON)
+    template <int waveType, bool stereo>
+    void renderScalar(Phase* phase, const Phase* phaseIncrement, float* gain,
+                      const float* envelopeMultiplier, const float* envelopeOffset,
+                      const float* panLeft, const float* panRight,
+                      int numLanes, float* outLeft, float* outRight, int numSamples) {
+        constexpr int width = 4;
+
+        for (int first = 0; first < numLanes; first += width) {
+            Phase p[width];
+            float g[width];
+            std::copy(phase + first, phase + first + width, p);
+            std::copy(gain + first, gain + first + width, g);
+
+            for (int i = 0; i < numSamples; ++i) {
+                float sumLeft = 0.0f, sumRight = 0.0f;
+
+                for (int lane = 0; lane < width; ++lane) {
+                    g[lane] = g[lane] * envelopeMultiplier[first + lane] + envelopeOffset[first + lane];
+                    const float sample = waveSample<waveType>(p[lane]) * g[lane];
+
+                    if constexpr (stereo) {
+                        sumLeft += sample * panLeft[first + lane];
+                        sumRight += sample * panRight[first + lane];
+                    } else {
+                        sumLeft += sample * panLeft[first + lane];
+                    }
+
+                    // Unsigned overflow is the wrap
+                    p[lane] += phaseIncrement[first + lane];
+                }
+
+                outLeft[i] += sumLeft;
+
+                if constexpr (stereo) {
+                    outRight[i] += sumRight;
+                }
+            }
+
+            std::copy(p, p + width, phase + first);
+            std::copy(g, g + width, gain + first);
+        }
+    }
+
+   #if JUCE_INTEL
+    //==============================================================================
+    HW4_TARGET("sse2") inline __m128 waveSampleSSE2(int waveType, __m128i phase) {
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        if (waveType == squareWave) {
+            // +1 below half a cycle, -1 above: the phase's top bit is the sign to apply to 1
+            const __m128i signBit = _mm_and_si128(phase, _mm_set1_epi32(static_cast<int>(PhaseAccumulator::halfCycle)));
+            return _mm_xor_ps(one, _mm_castsi128_ps(signBit));
+        }
+
+        const __m128 normalised = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(phase, 8)), _mm_set1_ps(phaseScale));
+
+        if (waveType == sineWave) {
+            const __m128 t = _mm_sub_ps(one, _mm_add_ps(normalised, normalised));
+            const __m128 t2 = _mm_mul_ps(t, t);
+            __m128 poly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sineC4), t2), _mm_set1_ps(sineC3));
+            poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(sineC2));
+            poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(sineC1));
+            poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(sineC0));
+            return _mm_mul_ps(_mm_mul_ps(t, _mm_sub_ps(one, t2)), poly);
+        }
+
+        return _mm_sub_ps(_mm_add_ps(normalised, normalised), one);
+    }
+
+    // Lane k of the result is the sum of every lane of sums[k]: a transpose turns
+    // four horizontal sums into three vertical adds
+    HW4_TARGET("sse2") inline __m128 transposeSumSSE2(const __m128* sums) {
+        __m128 row0 = sums[0], row1 = sums[1], row2 = sums[2], row3 = sums[3];
+        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+        return _mm_add_ps(_mm_add_ps(row0, row1), _mm_add_ps(row2, row3));
+    }
+
+    // Adds one sample per lane to out; a short final tile goes through memory
+    HW4_TARGET("sse2") inline void addTileSSE2(__m128 tile, float* out, int numSamples) {
+        if (numSamples == 4) {
+            _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), tile));
+            return;
+        }
+
+        alignas(16) float samples[4];
+        _mm_store_ps(samples, tile);
+
+        for (int i = 0; i < numSamples; ++i) {
+            out[i] += samples[i];
+        }
+    }
+
+    template <int waveType, bool stereo>
+    HW4_TARGET("sse2") void renderSSE2(Phase* phase, const Phase* phaseIncrement, float* gain,
+                                       const float* envelopeMultiplier, const float* envelopeOffset,
+                                       const float* panLeft, const float* panRight,
+                                       int numLanes, float* outLeft, float* outRight, int numSamples) {
+        constexpr int tileSize = 4;
+
+        // Every register of voices adds into one accumulator per sample of the tile, and
+        // the accumulators are only reduced once all the voices are in
+        for (int start = 0; start < numSamples; start += tileSize) {
+            const int tileSamples = juce::jmin(tileSize, numSamples - start);
+            __m128 sumLeft[tileSize], sumRight[tileSize];
+
+            for (int k = 0; k < tileSize; ++k) {
+                sumLeft[k] = _mm_setzero_ps();
+                sumRight[k] = _mm_setzero_ps();
+            }
+
+            for (int first = 0; first < numLanes; first += 4) {
+                __m128i p = _mm_load_si128(reinterpret_cast<const __m128i*>(phase + first));
+                __m128 g = _mm_load_ps(gain + first);
+                const __m128i increment = _mm_load_si128(reinterpret_cast<const __m128i*>(phaseIncrement + first));
+                const __m128 multiplier = _mm_load_ps(envelopeMultiplier + first);
+                const __m128 offset = _mm_load_ps(envelopeOffset + first);
+                const __m128 left = _mm_load_ps(panLeft + first);
+
+                for (int k = 0; k < tileSamples; ++k) {
+                    g = _mm_add_ps(_mm_mul_ps(g, multiplier), offset);
+                    const __m128 sample = _mm_mul_ps(waveSampleSSE2(waveType, p), g);
+                    sumLeft[k] = _mm_add_ps(sumLeft[k], _mm_mul_ps(sample, left));
+
+                    if constexpr (stereo) {
+                        sumRight[k] = _mm_add_ps(sumRight[k], _mm_mul_ps(sample, _mm_load_ps(panRight + first)));
+                    }
+
+                    p = _mm_add_epi32(p, increment);
+                }
+
+                _mm_store_si128(reinterpret_cast<__m128i*>(phase + first), p);
+                _mm_store_ps(gain + first, g);
+            }
+
+            addTileSSE2(transposeSumSSE2(sumLeft), outLeft + start, tileSamples);
+
+            if constexpr (stereo) {
+                addTileSSE2(transposeSumSSE2(sumRight), outRight + start, tileSamples);
+            }
+        }
+    }
+
+    //==============================================================================
+    HW4_TARGET("avx2,fma") inline __m256 waveSampleAVX2(int waveType, __m256i phase) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        if (waveType == squareWave) {
+            const __m256i signBit = _mm256_and_si256(phase, _mm256_set1_epi32(static_cast<int>(PhaseAccumulator::halfCycle)));
+            return _mm256_xor_ps(one, _mm256_castsi256_ps(signBit));
+        }
+
+        const __m256 normalised = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(phase, 8)), _mm256_set1_ps(phaseScale));
+
+        if (waveType == sineWave) {
+            const __m256 t = _mm256_fnmadd_ps(_mm256_set1_ps(2.0f), normalised, one);
+            const __m256 t2 = _mm256_mul_ps(t, t);
+            __m256 poly = _mm256_fmadd_ps(_mm256_set1_ps(sineC4), t2, _mm256_set1_ps(sineC3));
+            poly = _mm256_fmadd_ps(poly, t2, _mm256_set1_ps(sineC2));
+            poly = _mm256_fmadd_ps(poly, t2, _mm256_set1_ps(sineC1));
+            poly = _mm256_fmadd_ps(poly, t2, _mm256_set1_ps(sineC0));
+            return _mm256_mul_ps(_mm256_mul_ps(t, _mm256_sub_ps(one, t2)), poly);
+        }
+
+        return _mm256_fmsub_ps(_mm256_set1_ps(2.0f), normalised, one);
+    }
+
+    // Lane k of the result is the sum of every lane of sums[k]. Two rounds of pairwise adds
+    // leave each 128-bit half holding partial sums for four of them; one cross-half add finishes.
+    HW4_TARGET("avx2,fma") inline __m256 transposeSumAVX2(const __m256* sums) {
+        const __m256 sums0123 = _mm256_hadd_ps(_mm256_hadd_ps(sums[0], sums[1]), _mm256_hadd_ps(sums[2], sums[3]));
+        const __m256 sums4567 = _mm256_hadd_ps(_mm256_hadd_ps(sums[4], sums[5]), _mm256_hadd_ps(sums[6], sums[7]));
+        return _mm256_add_ps(_mm256_permute2f128_ps(sums0123, sums4567, 0x20), _mm256_permute2f128_ps(sums0123, sums4567, 0x31));
+    }
+
+    HW4_TARGET("avx2,fma") inline void addTileAVX2(__m256 tile, float* out, int numSamples) {
+        if (numSamples == 8) {
+            _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out), tile));
+            return;
+        }
+
+        alignas(32) float samples[8];
+        _mm256_store_ps(samples, tile);
+
+        for (int i = 0; i < numSamples; ++i) {
+            out[i] += samples[i];
+        }
+    }
+
+    template <int waveType, bool stereo>
+    HW4_TARGET("avx2,fma") void renderAVX2(Phase* phase, const Phase* phaseIncrement, float* gain,
+                                           const float* envelopeMultiplier, const float* envelopeOffset,
+                                           const float* panLeft, const float* panRight,
+                                           int numLanes, float* outLeft, float* outRight, int numSamples) {
+        constexpr int tileSize = 8;
+
+        for (int start = 0; start < numSamples; start += tileSize) {
+            const int tileSamples = juce::jmin(tileSize, numSamples - start);
+            __m256 sumLeft[tileSize], sumRight[tileSize];
+
+            for (int k = 0; k < tileSize; ++k) {
+                sumLeft[k] = _mm256_setzero_ps();
+                sumRight[k] = _mm256_setzero_ps();
+            }
+
+            for (int first = 0; first < numLanes; first += 8) {
+                __m256i p = _mm256_load_si256(reinterpret_cast<const __m256i*>(phase + first));
+                __m256 g = _mm256_load_ps(gain + first);
+                const __m256i increment = _mm256_load_si256(reinterpret_cast<const __m256i*>(phaseIncrement + first));
+                const __m256 multiplier = _mm256_load_ps(envelopeMultiplier + first);
+                const __m256 offset = _mm256_load_ps(envelopeOffset + first);
+                const __m256 left = _mm256_load_ps(panLeft + first);
+
+                for (int k = 0; k < tileSamples; ++k) {
+                    g = _mm256_fmadd_ps(g, multiplier, offset);
+                    const __m256 sample = _mm256_mul_ps(waveSampleAVX2(waveType, p), g);
+                    sumLeft[k] = _mm256_fmadd_ps(sample, left, sumLeft[k]);
+
+                    if constexpr (stereo) {
+                        sumRight[k] = _mm256_fmadd_ps(sample, _mm256_load_ps(panRight + first), sumRight[k]);
+                    }
+
+                    p = _mm256_add_epi32(p, increment);
+                }
+
+                _mm256_store_si256(reinterpret_cast<__m256i*>(phase + first), p);
+                _mm256_store_ps(gain + first, g);
+            }
+
+            addTileAVX2(transposeSumAVX2(sumLeft), outLeft + start, tileSamples);
+
+            if constexpr (stereo) {
+                addTileAVX2(transposeSumAVX2(sumRight), outRight + start, tileSamples);
+            }
+        }
+    }
+
+    //==============================================================================
+    HW4_TARGET("avx512f") inline __m512 waveSampleAVX512(int waveType, __m512i phase) {
+        const __m512 one = _mm512_set1_ps(1.0f);
+
+        if (waveType == squareWave) {
+            const __mmask16 upperHalf = _mm512_test_epi32_mask(phase, _mm512_set1_epi32(static_cast<int>(PhaseAccumulator::halfCycle)));
+            return _mm512_mask_blend_ps(upperHalf, one, _mm512_set1_ps(-1.0f));
+        }
+
+        const __m512 normalised = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(phase, 8)), _mm512_set1_ps(phaseScale));
+
+        if (waveType == sineWave) {
+            const __m512 t = _mm512_fnmadd_ps(_mm512_set1_ps(2.0f), normalised, one);
+            const __m512 t2 = _mm512_mul_ps(t, t);
+            __m512 poly = _mm512_fmadd_ps(_mm512_set1_ps(sineC4), t2, _mm512_set1_ps(sineC3));
+            poly = _mm512_fmadd_ps(poly, t2, _mm512_set1_ps(sineC2));
+            poly = _mm512_fmadd_ps(poly, t2, _mm512_set1_ps(sineC1));
+            poly = _mm512_fmadd_ps(poly, t2, _mm512_set1_ps(sineC0));
+            return _mm512_mul_ps(_mm512_mul_ps(t, _mm512_sub_ps(one, t2)), poly);
+        }
+
+        return _mm512_fmsub_ps(_mm512_set1_ps(2.0f), normalised, one);
+    }
+
+    // Folds each accumulator's upper eight lanes onto its lower eight, ready for the AVX2 reduction
+    struct HalvedSums { __m256 sums[8]; };
+
+    HW4_TARGET("avx512f") inline HalvedSums halveAVX512(const __m512* sums) {
+        HalvedSums halved;
+
+        for (int k = 0; k < 8; ++k) {
+            const __m256 low = _mm512_castps512_ps256(sums[k]);
+            const __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sums[k]), 1));
+            halved.sums[k] = _mm256_add_ps(low, high);
+        }
+
+        return halved;
+    }
+
+    template <int waveType, bool stereo>
+    HW4_TARGET("avx512f") void renderAVX512(Phase* phase, const Phase* phaseIncrement, float* gain,
+                                            const float* envelopeMultiplier, const float* envelopeOffset,
+                                            const float* panLeft, const float* panRight,
+                                            int numLanes, float* outLeft, float* outRight, int numSamples) {
+        // Eight samples a tile, as for AVX2: sixteen accumulators per channel would spill
+        constexpr int tileSize = 8;
+
+        for (int start = 0; start < numSamples; start += tileSize) {
+            const int tileSamples = juce::jmin(tileSize, numSamples - start);
+            __m512 sumLeft[tileSize], sumRight[tileSize];
+
+            for (int k = 0; k < tileSize; ++k) {
+                sumLeft[k] = _mm512_setzero_ps();
+                sumRight[k] = _mm512_setzero_ps();
+            }
+
+            for (int first = 0; first < numLanes; first += 16) {
+                __m512i p = _mm512_load_si512(phase + first);
+                __m512 g = _mm512_load_ps(gain + first);
+                const __m512i increment = _mm512_load_si512(phaseIncrement + first);
+                const __m512 multiplier = _mm512_load_ps(envelopeMultiplier + first);
+                const __m512 offset = _mm512_load_ps(envelopeOffset + first);
+                const __m512 left = _mm512_load_ps(panLeft + first);
+
+                for (int k = 0; k < tileSamples; ++k) {
+                    g = _mm512_fmadd_ps(g, multiplier, offset);
+                    const __m512 sample = _mm512_mul_ps(waveSampleAVX512(waveType, p), g);
+                    sumLeft[k] = _mm512_fmadd_ps(sample, left, sumLeft[k]);
+
+                    if constexpr (stereo) {
+                        sumRight[k] = _mm512_fmadd_ps(sample, _mm512_load_ps(panRight + first), sumRight[k]);
+                    }
+
+                    p = _mm512_add_epi32(p, increment);
+                }
+
+                _mm512_store_si512(phase + first, p);
+                _mm512_store_ps(gain + first, g);
+            }
+
+            addTileAVX2(transposeSumAVX2(halveAVX512(sumLeft).sums), outLeft + start, tileSamples);
+
+            if constexpr (stereo) {
+                addTileAVX2(transposeSumAVX2(halveAVX512(sumRight).sums), outRight + start, tileSamples);
+            }
+        }
+    }
+   #endif
+
+    //==============================================================================
+    using KernelsForWaves = std::array<Kernel, SIMDToneEngine::numWaveTypes>;
+
+    template <template <int, bool> class KernelFor, bool stereo>
+    constexpr KernelsForWaves makeKernels() {
+        return { KernelFor<sineWave, stereo>::kernel, KernelFor<squareWave, stereo>::kernel, KernelFor<sawtoothWave, stereo>::kernel };
+    }
+
+    // Mono, then stereo
+    template <template <int, bool> class KernelFor>
+    constexpr std::array<KernelsForWaves, 2> makeKernelsForLayouts() {
+        return { makeKernels<KernelFor, false>(), makeKernels<KernelFor, true>() };
+    }
+
+    template <int waveType, bool stereo> struct ScalarKernel { static constexpr Kernel kernel = renderScalar<waveType, stereo>; };
+   #if JUCE_INTEL
+    template <int waveType, bool stereo> struct SSE2Kernel   { static constexpr Kernel kernel = renderSSE2<waveType, stereo>; };
+    template <int waveType, bool stereo> struct AVX2Kernel   { static constexpr Kernel kernel = renderAVX2<waveType, stereo>; };
+    template <int waveType, bool stereo> struct AVX512Kernel { static constexpr Kernel kernel = renderAVX512<waveType, stereo>; };
+   #endif
+
+    // Indexed by instruction set, then output layout, then wave type
+    constexpr std::array<std::array<KernelsForWaves, 2>, 4> kernels
+    {
+        makeKernelsForLayouts<ScalarKernel>(),
+       #if JUCE_INTEL
+        makeKernelsForLayouts<SSE2Kernel>(),
+        makeKernelsForLayouts<AVX2Kernel>(),
+        makeKernelsForLayouts<AVX512Kernel>()
+       #else
+        makeKernelsForLayouts<ScalarKernel>(),
+        makeKernelsForLayouts<ScalarKernel>(),
+        makeKernelsForLayouts<ScalarKernel>()
+       #endif
+    };
+
+    // Lanes each kernel consumes per step; lane groups only need padding to this
+    constexpr std::array<int, 4> kernelWidths
+    {
+       #if JUCE_INTEL
+        4, 4, 8, 16
+       #else
+        4, 4, 4, 4
+       #endif
+    };
+}
+
+//==============================================================================
+// Constructor Definition
+SIMDToneEngine::SIMDToneEngine()
+    : instructionSet(getBestInstructionSet())
+{
+}
+
+// Best Instruction Set for this CPU
+SIMDToneEngine::InstructionSet SIMDToneEngine::getBestInstructionSet() {
+   #if JUCE_INTEL
+    if (juce::SystemStats::hasAVX512F()) {
+        return InstructionSet::avx512;
+    }
+
+    if (juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3()) {
+        return InstructionSet::avx2;
+    }
+
+    if (juce::SystemStats::hasSSE2()) {
+        return InstructionSet::sse2;
+    }
+   #endif
+
+    return InstructionSet::scalar;
+}
+
+// Set Instruction Set
+void SIMDToneEngine::setInstructionSet(InstructionSet newInstructionSet) {
+    instructionSet = std::min(newInstructionSet, getBestInstructionSet());
+}
+
+// Prepare Lanes
+void SIMDToneEngine::prepare(int maxVoices) {
+    jassert(maxVoices > 0);
+
+    laneCapacity = (maxVoices + maxLaneWidth - 1) / maxLaneWidth * maxLaneWidth;
+
+    // Seven 4-byte arrays per wave type, plus slack to round the base up to a cache line
+    constexpr int arraysPerWaveType = 7;
+    constexpr size_t alignment = 64;
+    const size_t arrayBytes = static_cast<size_t>(laneCapacity) * sizeof(float);
+    storage.allocate(arrayBytes * arraysPerWaveType * numWaveTypes + alignment, true);
+
+    auto* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(storage.get()) + alignment - 1) & ~(uintptr_t) (alignment - 1));
+
+    for (auto& waveLanes : lanes) {
+        waveLanes.phase = reinterpret_cast<PhaseAccumulator::Phase*>(aligned);
+        waveLanes.phaseIncrement = reinterpret_cast<PhaseAccumulator::Phase*>(aligned + arrayBytes);
+        waveLanes.gain = reinterpret_cast<float*>(aligned + arrayBytes * 2);
+        waveLanes.envelopeMultiplier = reinterpret_cast<float*>(aligned + arrayBytes * 3);
+        waveLanes.envelopeOffset = reinterpret_cast<float*>(aligned + arrayBytes * 4);
+        waveLanes.panLeft = reinterpret_cast<float*>(aligned + arrayBytes * 5);
+        waveLanes.panRight = reinterpret_cast<float*>(aligned + arrayBytes * 6);
+        aligned += arrayBytes * arraysPerWaveType;
+    }
+
+    clear();
+}
+
+// Clear Lanes
+void SIMDToneEngine::clear() {
+    for (auto& waveLanes : lanes) {
+        waveLanes.numVoices = 0;
+    }
+}
+
+// Add Voice
+int SIMDToneEngine::addVoice(int waveType, const ToneLaneState& state) {
+    jassert(juce::isPositiveAndBelow(waveType, numWaveTypes));
+
+    auto& waveLanes = lanes[static_cast<size_t>(waveType)];
+    jassert(waveLanes.numVoices < laneCapacity);
+
+    const int lane = waveLanes.numVoices++;
+    waveLanes.phase[lane] = state.phase;
+    waveLanes.phaseIncrement[lane] = state.phaseIncrement;
+    waveLanes.gain[lane] = state.gain;
+    waveLanes.envelopeMultiplier[lane] = state.envelopeMultiplier;
+    waveLanes.envelopeOffset[lane] = state.envelopeOffset;
+    waveLanes.panLeft[lane] = state.panLeft;
+    waveLanes.panRight[lane] = state.panRight;
+
+    return waveType * laneCapacity + lane;
+}
+
+// Read Back Voice
+ToneLaneState SIMDToneEngine::getVoice(int handle) const {
+    const auto& waveLanes = lanes[static_cast<size_t>(handle / laneCapacity)];
+    const int lane = handle % laneCapacity;
+
+    return { waveLanes.phase[lane], waveLanes.phaseIncrement[lane], waveLanes.gain[lane],
+             waveLanes.envelopeMultiplier[lane], waveLanes.envelopeOffset[lane],
+             waveLanes.panLeft[lane], waveLanes.panRight[lane] };
+}
+
+// Replace Voice
+void SIMDToneEngine::setVoice(int handle, const ToneLaneState& state) {
+    auto& waveLanes = lanes[static_cast<size_t>(handle / laneCapacity)];
+    const int lane = handle % laneCapacity;
+
+    waveLanes.phase[lane] = state.phase;
+    waveLanes.phaseIncrement[lane] = state.phaseIncrement;
+    waveLanes.gain[lane] = state.gain;
+    waveLanes.envelopeMultiplier[lane] = state.envelopeMultiplier;
+    waveLanes.envelopeOffset[lane] = state.envelopeOffset;
+    waveLanes.panLeft[lane] = state.panLeft;
+    waveLanes.panRight[lane] = state.panRight;
+}
+
+// Render
+void SIMDToneEngine::render(float* outLeft, float* outRight, int numSamples) {
+    const auto& kernelsForSet = kernels[static_cast<size_t>(instructionSet)][outRight != nullptr ? 1 : 0];
+
+    for (int waveType = 0; waveType < numWaveTypes; ++waveType) {
+        auto& waveLanes = lanes[static_cast<size_t>(waveType)];
+
+        if (waveLanes.numVoices == 0) {
+            continue;
+        }
+
+        // Silence the padding lanes so the kernel can always run whole registers
+        const int width = kernelWidths[static_cast<size_t>(instructionSet)];
+        const int numLanes = (waveLanes.numVoices + width - 1) / width * width;
+
+        for (int lane = waveLanes.numVoices; lane < numLanes; ++lane) {
+            waveLanes.phase[lane] = 0;
+            waveLanes.phaseIncrement[lane] = 0;
+            waveLanes.gain[lane] = 0.0f;
+            waveLanes.envelopeMultiplier[lane] = 0.0f;
+            waveLanes.envelopeOffset[lane] = 0.0f;
+            waveLanes.panLeft[lane] = 0.0f;
+            waveLanes.panRight[lane] = 0.0f;
+        }
+
+        kernelsForSet[static_cast<size_t>(waveType)](waveLanes.phase, waveLanes.phaseIncrement, waveLanes.gain,
+                                                     waveLanes.envelopeMultiplier, waveLanes.envelopeOffset,
+                                                     waveLanes.panLeft, waveLanes.panRight,
+                                                     numLanes, outLeft, outRight, numSamples);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    SIMDToneEngine.h
+
+    Structure-of-arrays oscillator engine that renders many tones per
+    instruction. Each block the ToneBank packs its active tones into
+    contiguous, 64-byte aligned lanes grouped by wave type, the engine runs
+    a branch-free kernel over them and the updated state is read back.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "PhaseAccumulator.h"
+
+// The per-block state of one tone, as packed into a lane
+struct ToneLaneState
+{
+    PhaseAccumulator::Phase phase;            // Fixed-point phase, 2^32 per cycle
+    PhaseAccumulator::Phase phaseIncrement;   // Phase advance per sample
+    float gain;                               // Current envelope gain
+    float envelopeMultiplier;                 // Each sample the gain becomes gain * multiplier + offset,
+    float envelopeOffset;                     // which covers every envelope segment
+    float panLeft = 1.0f, panRight = 1.0f;    // Channel gains; a mono render weights each lane by panLeft
+};
+
+class SIMDToneEngine
+{
+public:
+    enum class InstructionSet { scalar, sse2, avx2, avx512 };
+
+    // Matches the number of Tone::WaveType values
+    static constexpr int numWaveTypes = 3;
+
+    SIMDToneEngine();
+
+    // Allocates aligned lanes for up to maxVoices tones of every wave type
+    void prepare(int maxVoices);
+
+    // Picks a kernel; requests the CPU can't run fall back to the best supported set
+    void setInstructionSet(InstructionSet newInstructionSet);
+    InstructionSet getInstructionSet() const { return instructionSet; }
+    static InstructionSet getBestInstructionSet();
+
+    // Packing: clear(), addVoice() for every tone, render(), then getVoice() to read back
+    void clear();
+    int addVoice(int waveType, const ToneLaneState& state);
+    ToneLaneState getVoice(int handle) const;
+    // Replaces a packed tone's state between render() calls, e.g. when its envelope changes segment mid-block
+    void setVoice(int handle, const ToneLaneState& state);
+
+    // Adds the panLeft-weighted sum of all packed tones to outLeft, or the panned sums to outLeft and
+    // outRight when outRight isn't null; can be called repeatedly to render a block in pieces
+    void render(float* outLeft, float* outRight, int numSamples);
+
+    // Lane storage is padded to the widest vector so every kernel can run whole registers
+    static constexpr int maxLaneWidth = 16;
+
+private:
+    struct Lanes
+    {
+        PhaseAccumulator::Phase* phase = nullptr;
+        PhaseAccumulator::Phase* phaseIncrement = nullptr;
+        float* gain = nullptr;
+        float* envelopeMultiplier = nullptr;
+        float* envelopeOffset = nullptr;
+        float* panLeft = nullptr;
+        float* panRight = nullptr;
+        int numVoices = 0;
+    };
+
+    std::array<Lanes, numWaveTypes> lanes;
+    juce::HeapBlock<char> storage;
+    int laneCapacity = 0;
+    InstructionSet instructionSet = InstructionSet::scalar;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SIMDToneEngine)
+};
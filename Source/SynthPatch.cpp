@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    SynthPatch.cpp
+
+  ==============================================================================
+*/
+
+#include "SynthPatch.h"
+
+// Prepare Patch
+void SynthPatch::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+    envelopeParameters = envelopeParametersFor(values);
+    envelopeCoefficients = EnvelopeCoefficients::calculate(envelopeParameters, sampleRate);
+}
+
+// Envelope Parameters
+EnvelopeParameters SynthPatch::envelopeParametersFor(const Values& values) {
+    EnvelopeParameters parameters;
+    parameters.attackMilliseconds = values[attack];
+    parameters.decayMilliseconds = values[decay];
+    parameters.sustainLevel = values[sustain] * 0.01;
+    parameters.releaseMilliseconds = values[release];
+    parameters.cullDecibels = values[cullFloor];
+    return parameters;
+}
+
+// Write State
+void SynthPatch::writeState(juce::OutputStream& stream, const Values& values, int program) {
+    stream.writeInt(stateMagic);
+    stream.writeInt(stateVersion);
+    stream.writeInt(program);
+    stream.writeInt(numValues);
+
+    for (const float value : values) {
+        stream.writeFloat(value);
+    }
+}
+
+// Read State
+bool SynthPatch::readState(const void* data, size_t sizeInBytes, Values& values, int& program) {
+    juce::MemoryInputStream stream(data, sizeInBytes, false);
+
+    constexpr int headerBytes = 4 * static_cast<int>(sizeof(juce::int32));
+
+    if (stream.getTotalLength() < headerBytes || stream.readInt() != stateMagic) {
+        return false;
+    }
+
+    // Later versions only append, so anything from version 1 on can be read this far
+    if (stream.readInt() < 1) {
+        return false;
+    }
+
+    const int storedProgram = stream.readInt();
+    const int numStored = stream.readInt();
+
+    if (numStored < 0 || stream.getNumBytesRemaining() < static_cast<juce::int64>(numStored) * static_cast<juce::int64>(sizeof(float))) {
+        return false;
+    }
+
+    for (int i = 0; i < juce::jmin(numStored, static_cast<int>(numValues)); ++i) {
+        values[static_cast<size_t>(i)] = stream.readFloat();
+    }
+
+    program = storedProgram;
+    return true;
+}
+
+//==============================================================================
+// Destructor Definition
+PatchExchange::~PatchExchange() {
+    collectGarbage();
+    delete pending.exchange(nullptr);
+}
+
+// Publish
+void PatchExchange::publish(std::unique_ptr<SynthPatch> patch) {
+    // Empty the return queue first, so the audio thread always has room to hand this one back
+    collectGarbage();
+
+    // Nobody else can be holding a patch that was still pending
+    delete pending.exchange(patch.release(), std::memory_order_acq_rel);
+}
+
+// Collect Garbage
+void PatchExchange::collectGarbage() {
+    const juce::AbstractFifo::ScopedRead read(retiredFifo, retiredFifo.getNumReady());
+
+    for (int i = 0; i < read.blockSize1; ++i) {
+        delete retired[static_cast<size_t>(read.startIndex1 + i)];
+    }
+
+    for (int i = 0; i < read.blockSize2; ++i) {
+        delete retired[static_cast<size_t>(read.startIndex2 + i)];
+    }
+}
+
+// Take
+SynthPatch* PatchExchange::take() {
+    // Leave the patch pending until there is somewhere to return it to
+    if (pending.load(std::memory_order_relaxed) == nullptr || retiredFifo.getFreeSpace() == 0) {
+        return nullptr;
+    }
+
+    return pending.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+// Retire
+void PatchExchange::retire(SynthPatch* patch) {
+    if (patch == nullptr) {
+        return;
+    }
+
+    const juce::AbstractFifo::ScopedWrite write(retiredFifo, 1);
+    jassert(write.blockSize1 == 1);
+
+    retired[static_cast<size_t>(write.startIndex1)] = patch;
+}
@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    SynthPatch.h
+
+    A complete set of synth settings plus everything derived from them, and
+    the lock-free hand-off that gets one onto the audio thread. Patches are
+    built and prepared on the message thread, published with a single
+    pointer exchange, and handed back for deletion, so the audio thread
+    never allocates, frees or waits when a preset is recalled.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "MIDISynth.h"
+
+class SynthPatch
+{
+public:
+    // Saved values, in the order the binary state stores them; only ever append
+    enum Value {masterGain, waveType, attack, decay, sustain, release, cullFloor, voiceStealing, polyphony, renderThreads, multiTimbral, loadGovernor, numValues};
+
+    using Values = std::array<float, numValues>;
+
+    explicit SynthPatch(const Values& newValues) : values(newValues) {}
+
+    // Works out the derived coefficients; call off the audio thread
+    void prepare(double newSampleRate);
+
+    const Values& getValues() const { return values; }
+    float get(Value value) const { return values[static_cast<size_t>(value)]; }
+
+    // Derived state, valid once prepared
+    double getSampleRate() const { return sampleRate; }
+    const EnvelopeParameters& getEnvelopeParameters() const { return envelopeParameters; }
+    const EnvelopeCoefficients& getEnvelopeCoefficients() const { return envelopeCoefficients; }
+
+    // Sustain is stored as a percentage, like its parameter
+    static EnvelopeParameters envelopeParametersFor(const Values& values);
+
+    // Binary state: magic, format version, program, value count, then the values as floats.
+    // Readers take the values they know and keep the defaults for any that are missing.
+    static constexpr juce::int32 stateMagic = 0x50345748;   // "HW4P"
+    static constexpr juce::int32 stateVersion = 1;
+
+    static void writeState(juce::OutputStream& stream, const Values& values, int program);
+    // False if the data isn't in the binary format; values and program are only changed on success
+    static bool readState(const void* data, size_t sizeInBytes, Values& values, int& program);
+
+private:
+    Values values;
+    double sampleRate = 0.0;
+    EnvelopeParameters envelopeParameters;
+    EnvelopeCoefficients envelopeCoefficients;
+};
+
+// Single producer (message thread), single consumer (audio thread)
+class PatchExchange
+{
+public:
+    PatchExchange() = default;
+    ~PatchExchange();
+
+    // Message thread: replaces any patch the audio thread hasn't taken yet, and frees returned ones
+    void publish(std::unique_ptr<SynthPatch> patch);
+    void collectGarbage();
+
+    // Audio thread: the newest published patch, or nullptr. Hand it back with retire() once applied.
+    SynthPatch* take();
+    void retire(SynthPatch* patch);
+
+private:
+    static constexpr int retiredCapacity = 8;
+
+    std::atomic<SynthPatch*> pending { nullptr };
+    juce::AbstractFifo retiredFifo { retiredCapacity };
+    std::array<SynthPatch*, retiredCapacity> retired {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PatchExchange)
+};
@@ -0,0 +1,334 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.cpp
+
+  ==============================================================================
+*/
+
+#include "TraceRecorder.h"
+
+#if HW4_TRACING
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    using EventType = TraceRecorder::EventType;
+    using Phase = TraceRecorder::Phase;
+
+    struct Record
+    {
+        juce::int64 ticks;
+        EventType type;
+        Phase phase;
+        juce::int32 firstValue, secondValue;
+    };
+
+    // One per tracing thread: that thread is the only writer, the drain thread the only reader
+    struct ThreadRing
+    {
+        // A thread claims a free ring and releases it when it exits; the drain thread empties a
+        // released ring and only then frees it, so a new owner never inherits old records
+        enum State {free, claiming, claimed, released};
+
+        alignas(64) std::atomic<juce::uint32> writePosition { 0 };
+        alignas(64) std::atomic<juce::uint32> readPosition { 0 };
+        std::atomic<juce::uint32> numDropped { 0 };
+        std::atomic<int> state { free };
+        juce::String threadName;   // Written while claiming, before claimed is published
+        std::array<Record, TraceRecorder::recordsPerThread> records;
+    };
+
+    struct EventDescription
+    {
+        const char* name;
+        const char* firstArgument;
+        const char* secondArgument;
+    };
+
+    constexpr std::array<EventDescription, static_cast<size_t>(EventType::numEventTypes)> eventDescriptions {{
+        { "processBlock", "numSamples", "voices" },
+        { "renderPass", "numSamples", "voices" },
+        { "voiceChunk", "participant", "voices" },
+        { "noteOn", "channel", "note" },
+        { "noteOff", "channel", "note" },
+        { "voiceSteal", "channel", "note" },
+        { "voiceRetire", "channel", "note" }
+    }};
+
+    // The time stamp counter where there is one, which reads in a few nanoseconds where
+    // the OS clock can take tens; elsewhere the high-resolution clock is already that cheap
+    inline juce::int64 readClock() {
+       #if JUCE_INTEL
+        return static_cast<juce::int64>(__rdtsc());
+       #else
+        return juce::Time::getHighResolutionTicks();
+       #endif
+    }
+
+    // Measured against the high-resolution clock by the first start()
+    double clockTicksPerMicrosecond = 0.0;
+
+    void calibrateClock() {
+       #if JUCE_INTEL
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        const auto startClock = readClock();
+        juce::Thread::sleep(20);
+        const auto elapsedClock = readClock() - startClock;
+        const auto elapsedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        clockTicksPerMicrosecond = static_cast<double>(elapsedClock) / (elapsedSeconds * 1.0e6);
+       #else
+        clockTicksPerMicrosecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()) * 1.0e-6;
+       #endif
+    }
+
+    // Rings are allocated by the first start() and then live as long as the process, since
+    // threads keep pointers to theirs in thread-local storage
+    std::array<std::unique_ptr<ThreadRing>, TraceRecorder::maxThreads> rings;
+
+    // Gives the calling thread a ring of its own, or nullptr while every ring is taken
+    ThreadRing* claimRing() {
+        for (auto& ring : rings) {
+            int expected = ThreadRing::free;
+
+            if (!ring->state.compare_exchange_strong(expected, ThreadRing::claiming, std::memory_order_acquire)) {
+                continue;
+            }
+
+            // Host audio threads aren't juce::Threads; the writer names those by number
+            auto* thread = juce::Thread::getCurrentThread();
+            ring->threadName = thread != nullptr ? thread->getThreadName() : juce::String();
+
+            ring->state.store(ThreadRing::claimed, std::memory_order_release);
+            return ring.get();
+        }
+
+        return nullptr;
+    }
+
+    // The calling thread's ring, handed back when the thread exits; voice workers are
+    // recreated every time the renderer is prepared, so rings have to outlive their threads
+    struct RingClaim
+    {
+        ThreadRing* const ring = claimRing();
+
+        ~RingClaim() {
+            if (ring != nullptr) {
+                ring->state.store(ThreadRing::released, std::memory_order_release);
+            }
+        }
+    };
+
+    //==============================================================================
+    // Drains every ring into a Chrome trace-event JSON file
+    class Writer : public juce::Thread
+    {
+    public:
+        explicit Writer(std::unique_ptr<juce::FileOutputStream> streamToUse)
+            : juce::Thread("Trace Writer"),
+              stream(std::move(streamToUse)),
+              startTicks(readClock()),
+              microsecondsPerTick(1.0 / clockTicksPerMicrosecond)
+        {
+            // Whatever is still queued from an earlier recording doesn't belong in this one, and
+            // rings released since then have no one left to drain them
+            for (auto& ring : rings) {
+                ring->readPosition.store(ring->writePosition.load(std::memory_order_acquire), std::memory_order_release);
+                droppedAtStart[static_cast<size_t>(&ring - rings.data())] = ring->numDropped.load(std::memory_order_relaxed);
+
+                int expected = ThreadRing::released;
+                ring->state.compare_exchange_strong(expected, ThreadRing::free, std::memory_order_acq_rel);
+            }
+
+            *stream << "{\"traceEvents\":[\n";
+        }
+
+        void run() override {
+            while (!threadShouldExit()) {
+                drain();
+                wait(drainIntervalMs);
+            }
+        }
+
+        // Stops the thread, writes whatever it hadn't got to and closes the JSON
+        void finish() {
+            stopThread(1000);
+            drain();
+
+            juce::uint32 numDropped = 0;
+
+            for (size_t slot = 0; slot < rings.size(); ++slot) {
+                numDropped += rings[slot]->numDropped.load(std::memory_order_relaxed) - droppedAtStart[slot];
+            }
+
+            *stream << "\n],\"otherData\":{\"droppedEvents\":" << static_cast<int>(numDropped) << "}}\n";
+            stream->flush();
+        }
+
+    private:
+        static constexpr int drainIntervalMs = 20;
+
+        std::unique_ptr<juce::FileOutputStream> stream;
+        const juce::int64 startTicks;
+        const double microsecondsPerTick;
+        std::array<bool, TraceRecorder::maxThreads> named {};
+        std::array<int, TraceRecorder::maxThreads> threadIds {};   // Per ring owner, so a recycled ring starts a new track
+        int nextThreadId = 0;
+        std::array<juce::uint32, TraceRecorder::maxThreads> droppedAtStart {};
+        bool firstEvent = true;
+
+        void drain() {
+            for (int slot = 0; slot < TraceRecorder::maxThreads; ++slot) {
+                auto& ring = *rings[static_cast<size_t>(slot)];
+                const int state = ring.state.load(std::memory_order_acquire);
+
+                if (state != ThreadRing::claimed && state != ThreadRing::released) {
+                    continue;
+                }
+
+                const auto writePosition = ring.writePosition.load(std::memory_order_acquire);
+                auto readPosition = ring.readPosition.load(std::memory_order_relaxed);
+
+                if (readPosition != writePosition) {
+                    auto& threadId = threadIds[static_cast<size_t>(slot)];
+
+                    if (!named[static_cast<size_t>(slot)]) {
+                        threadId = nextThreadId++;
+                        writeThreadName(threadId, ring.threadName.isNotEmpty() ? ring.threadName : "Thread " + juce::String(threadId));
+                        named[static_cast<size_t>(slot)] = true;
+                    }
+
+                    for (; readPosition != writePosition; ++readPosition) {
+                        writeRecord(threadId, ring.records[static_cast<size_t>(readPosition % TraceRecorder::recordsPerThread)]);
+                    }
+
+                    ring.readPosition.store(readPosition, std::memory_order_release);
+                }
+
+                // Its thread has exited and everything it wrote is out, so the ring can go to the next one
+                if (state == ThreadRing::released) {
+                    named[static_cast<size_t>(slot)] = false;
+                    ring.state.store(ThreadRing::free, std::memory_order_release);
+                }
+            }
+        }
+
+        void writeThreadName(int threadId, const juce::String& name) {
+            writeSeparator();
+            *stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId
+                    << ",\"args\":{\"name\":" << juce::JSON::toString(name) << "}}";
+        }
+
+        void writeRecord(int threadId, const Record& record) {
+            // Stragglers written just before the previous recording stopped
+            if (record.ticks < startTicks) {
+                return;
+            }
+
+            const auto& description = eventDescriptions[static_cast<size_t>(record.type)];
+            const double timestamp = static_cast<double>(record.ticks - startTicks) * microsecondsPerTick;
+            char line[256];
+            int length = 0;
+
+            switch (record.phase) {
+                case Phase::begin:
+                case Phase::instant:
+                    length = std::snprintf(line, sizeof(line),
+                                           "{\"name\":\"%s\",\"cat\":\"hw4\",\"ph\":%s,\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"%s\":%d,\"%s\":%d}}",
+                                           description.name, record.phase == Phase::begin ? "\"B\"" : "\"i\",\"s\":\"t\"", timestamp, threadId,
+                                           description.firstArgument, record.firstValue, description.secondArgument, record.secondValue);
+                    break;
+
+                case Phase::end:
+                    length = std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"hw4\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                                           description.name, timestamp, threadId);
+                    break;
+            }
+
+            writeSeparator();
+            stream->write(line, static_cast<size_t>(juce::jlimit(0, static_cast<int>(sizeof(line)) - 1, length)));
+        }
+
+        void writeSeparator() {
+            if (!firstEvent) {
+                *stream << ",\n";
+            }
+
+            firstEvent = false;
+        }
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Writer)
+    };
+
+    std::unique_ptr<Writer> writer;
+}
+
+// Start
+bool TraceRecorder::start(const juce::File& file) {
+    stop();
+
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+    if (stream->failedToOpen()) {
+        return false;
+    }
+
+    stream->setPosition(0);
+    stream->truncate();
+
+    if (rings.front() == nullptr) {
+        calibrateClock();
+
+        for (auto& ring : rings) {
+            ring = std::make_unique<ThreadRing>();
+        }
+    }
+
+    writer = std::make_unique<Writer>(std::move(stream));
+    writer->startThread();
+
+    // Release so a thread that sees the flag also sees the rings
+    recording.store(true, std::memory_order_release);
+    return true;
+}
+
+// Stop
+void TraceRecorder::stop() {
+    recording.store(false);
+
+    if (writer != nullptr) {
+        writer->finish();
+        writer.reset();
+    }
+}
+
+// Write
+void TraceRecorder::write(EventType type, Phase phase, int firstValue, int secondValue) {
+    // Claimed on the thread's first event and kept until it exits; a thread that found no ring free stays silent
+    thread_local const RingClaim claim;
+    auto* const ring = claim.ring;
+
+    if (ring == nullptr) {
+        return;
+    }
+
+    const auto position = ring->writePosition.load(std::memory_order_relaxed);
+
+    if (position - ring->readPosition.load(std::memory_order_acquire) >= static_cast<juce::uint32>(recordsPerThread)) {
+        ring->numDropped.store(ring->numDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring->records[static_cast<size_t>(position % recordsPerThread)] = { readClock(), type, phase, firstValue, secondValue };
+    ring->writePosition.store(position + 1, std::memory_order_release);
+}
+
+#endif
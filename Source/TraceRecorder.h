@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.h
+
+    Timeline tracing for chasing glitches: block and render-pass spans,
+    note-ons and offs, and voice steals and retirements, written out as
+    Chrome trace-event JSON for chrome://tracing or Perfetto.
+
+    Compiled in only when HW4_TRACING is defined to 1 (the Debug
+    configurations do); otherwise the HW4_TRACE macros expand to nothing.
+    Compiled in but not recording, each trace point is one relaxed load and
+    a branch. While recording, every thread that traces claims its own
+    single-producer ring of fixed-size binary records, and hands it back
+    when it exits. Writing an event is a timestamp (the TSC on Intel), one
+    record copy and a release store; nothing locks or allocates. A
+    background thread drains the rings into the file. Events that find
+    their ring full are dropped and counted rather than blocking.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+#ifndef HW4_TRACING
+ #define HW4_TRACING 0
+#endif
+
+#if HW4_TRACING
+
+class TraceRecorder
+{
+public:
+    enum class EventType : juce::uint8
+    {
+        processBlock,   // numSamples, voices
+        renderPass,     // numSamples, voices
+        voiceChunk,     // participant, voices
+        noteOn,         // channel, note
+        noteOff,        // channel, note
+        voiceSteal,     // channel, note of the tone taken over
+        voiceRetire,    // channel, note of the tone whose release finished
+        numEventTypes
+    };
+
+    enum class Phase : juce::uint8 {begin, end, instant};
+
+    static constexpr int maxThreads = 32;   // Tracing at the same time; rings are reused as threads exit
+    static constexpr int recordsPerThread = 1 << 14;
+
+    // Message thread. Starting discards anything older; stopping drains what is left and closes the file.
+    static bool start(const juce::File& file);
+    static void stop();
+    static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+    // Any thread, but only while recording; the HW4_TRACE macros check first, so arguments
+    // cost nothing when no one is recording
+    static void write(EventType type, Phase phase, int firstValue, int secondValue);
+
+    // A begin/end pair around a scope, with the arguments attached to the begin
+    class Scope
+    {
+    public:
+        Scope(EventType typeToUse, int firstValue, int secondValue) : type(typeToUse), active(isRecording()) {
+            if (active) {
+                write(type, Phase::begin, firstValue, secondValue);
+            }
+        }
+
+        ~Scope() {
+            if (active) {
+                write(type, Phase::end, 0, 0);
+            }
+        }
+
+    private:
+        const EventType type;
+        const bool active;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+private:
+    inline static std::atomic<bool> recording { false };
+};
+
+ #define HW4_TRACE_CONCAT_(a, b) a##b
+ #define HW4_TRACE_CONCAT(a, b) HW4_TRACE_CONCAT_(a, b)
+ #define HW4_TRACE_SCOPE(type, firstValue, secondValue) \
+    const TraceRecorder::Scope HW4_TRACE_CONCAT(traceScope, __LINE__) (TraceRecorder::EventType::type, (firstValue), (secondValue))
+ #define HW4_TRACE_EVENT(type, firstValue, secondValue) \
+    do { \
+        if (TraceRecorder::isRecording()) \
+            TraceRecorder::write(TraceRecorder::EventType::type, TraceRecorder::Phase::instant, (firstValue), (secondValue)); \
+    } while (false)
+
+#else
+
+ #define HW4_TRACE_SCOPE(type, firstValue, secondValue)
+ #define HW4_TRACE_EVENT(type, firstValue, secondValue) do {} while (false)
+
+#endif
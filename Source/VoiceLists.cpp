@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+    VoiceLists.cpp
+
+  ==============================================================================
+*/
+
+#include "VoiceLists.h"
+
+//==============================================================================
+// Prepare Lists
+void IndexListSet::prepare(int numLists, int capacity) {
+    jassert(numLists > 0 && capacity > 0);
+
+    previous.resize(static_cast<size_t>(capacity));
+    next.resize(static_cast<size_t>(capacity));
+    listOf.resize(static_cast<size_t>(capacity));
+    heads.resize(static_cast<size_t>(numLists));
+    tails.resize(static_cast<size_t>(numLists));
+
+    clear();
+}
+
+// Clear Lists
+void IndexListSet::clear() {
+    std::fill(listOf.begin(), listOf.end(), -1);
+    std::fill(heads.begin(), heads.end(), -1);
+    std::fill(tails.begin(), tails.end(), -1);
+}
+
+// Append to the end of a list
+void IndexListSet::append(int list, int index) {
+    jassert(!contains(index));
+
+    auto& tail = tails[static_cast<size_t>(list)];
+
+    previous[static_cast<size_t>(index)] = tail;
+    next[static_cast<size_t>(index)] = -1;
+    listOf[static_cast<size_t>(index)] = list;
+
+    if (tail >= 0) {
+        next[static_cast<size_t>(tail)] = index;
+    } else {
+        heads[static_cast<size_t>(list)] = index;
+    }
+
+    tail = index;
+}
+
+// Remove from whichever list holds the index
+void IndexListSet::remove(int index) {
+    const int list = listOf[static_cast<size_t>(index)];
+
+    if (list < 0) {
+        return;
+    }
+
+    const int before = previous[static_cast<size_t>(index)];
+    const int after = next[static_cast<size_t>(index)];
+
+    if (before >= 0) {
+        next[static_cast<size_t>(before)] = after;
+    } else {
+        heads[static_cast<size_t>(list)] = after;
+    }
+
+    if (after >= 0) {
+        previous[static_cast<size_t>(after)] = before;
+    } else {
+        tails[static_cast<size_t>(list)] = before;
+    }
+
+    listOf[static_cast<size_t>(index)] = -1;
+}
+
+//==============================================================================
+// Prepare Heap
+void IndexedMinHeap::prepare(int capacity) {
+    jassert(capacity > 0);
+
+    heap.resize(static_cast<size_t>(capacity));
+    positions.resize(static_cast<size_t>(capacity));
+    keys.resize(static_cast<size_t>(capacity));
+
+    clear();
+}
+
+// Clear Heap
+void IndexedMinHeap::clear() {
+    std::fill(positions.begin(), positions.end(), -1);
+    size = 0;
+}
+
+// Insert
+void IndexedMinHeap::insert(int index, float key) {
+    jassert(!contains(index) && size < static_cast<int>(heap.size()));
+
+    keys[static_cast<size_t>(index)] = key;
+    place(size++, index);
+    siftUp(size - 1);
+}
+
+// Remove
+void IndexedMinHeap::remove(int index) {
+    const int position = positions[static_cast<size_t>(index)];
+
+    if (position < 0) {
+        return;
+    }
+
+    positions[static_cast<size_t>(index)] = -1;
+
+    // Fill the hole with the last entry and let it settle in whichever direction it needs
+    if (position != --size) {
+        const int moved = heap[static_cast<size_t>(size)];
+        place(position, moved);
+        siftUp(position);
+        siftDown(positions[static_cast<size_t>(moved)]);
+    }
+}
+
+// Set Key
+void IndexedMinHeap::setKey(int index, float key) {
+    const int position = positions[static_cast<size_t>(index)];
+    jassert(position >= 0);
+
+    keys[static_cast<size_t>(index)] = key;
+    siftUp(position);
+    siftDown(positions[static_cast<size_t>(index)]);
+}
+
+void IndexedMinHeap::place(int position, int index) {
+    heap[static_cast<size_t>(position)] = index;
+    positions[static_cast<size_t>(index)] = position;
+}
+
+void IndexedMinHeap::siftUp(int position) {
+    const int index = heap[static_cast<size_t>(position)];
+
+    while (position > 0) {
+        const int parent = (position - 1) / 2;
+
+        if (!isBelow(index, heap[static_cast<size_t>(parent)])) {
+            break;
+        }
+
+        place(position, heap[static_cast<size_t>(parent)]);
+        position = parent;
+    }
+
+    place(position, index);
+}
+
+void IndexedMinHeap::siftDown(int position) {
+    const int index = heap[static_cast<size_t>(position)];
+
+    for (;;) {
+        int child = 2 * position + 1;
+
+        if (child >= size) {
+            break;
+        }
+
+        if (child + 1 < size && isBelow(heap[static_cast<size_t>(child + 1)], heap[static_cast<size_t>(child)])) {
+            ++child;
+        }
+
+        if (!isBelow(heap[static_cast<size_t>(child)], index)) {
+            break;
+        }
+
+        place(position, heap[static_cast<size_t>(child)]);
+        position = child;
+    }
+
+    place(position, index);
+}
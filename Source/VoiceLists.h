@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    VoiceLists.h
+
+    Index-based containers for tracking voices by their slot in the tone
+    pool. Storage is allocated in prepare(); every other call is O(1) or
+    O(log n) and never allocates, so they can be used on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+// A set of doubly linked lists over the indices [0, capacity). Each index is in at most
+// one list at a time, so all the lists share one pair of link arrays.
+class IndexListSet
+{
+public:
+    void prepare(int numLists, int capacity);
+    void clear();
+
+    void append(int list, int index);
+    void remove(int index);
+
+    bool contains(int index) const { return listOf[static_cast<size_t>(index)] >= 0; }
+    bool isEmpty(int list) const { return heads[static_cast<size_t>(list)] < 0; }
+
+    // -1 when there is no such entry
+    int getFirst(int list) const { return heads[static_cast<size_t>(list)]; }
+    int getNext(int index) const { return next[static_cast<size_t>(index)]; }
+
+private:
+    std::vector<int> previous, next, listOf;
+    std::vector<int> heads, tails;
+};
+
+// Binary min-heap of indices in [0, capacity) with a key per index. Each index
+// remembers its heap position, so any entry can be removed or rekeyed in O(log n).
+class IndexedMinHeap
+{
+public:
+    void prepare(int capacity);
+    void clear();
+
+    void insert(int index, float key);
+    void remove(int index);
+    void setKey(int index, float key);
+
+    bool contains(int index) const { return positions[static_cast<size_t>(index)] >= 0; }
+    bool isEmpty() const { return size == 0; }
+    int getTop() const { return size > 0 ? heap[0] : -1; }
+
+private:
+    std::vector<int> heap, positions;
+    std::vector<float> keys;
+    int size = 0;
+
+    bool isBelow(int a, int b) const { return keys[static_cast<size_t>(a)] < keys[static_cast<size_t>(b)]; }
+    void place(int position, int index);
+    void siftUp(int position);
+    void siftDown(int position);
+};
@@ -0,0 +1,43 @@
+/*
+  ==============================================================================
+
+    Wavetable.cpp
+
+  ==============================================================================
+*/
+
+#include "Wavetable.h"
+
+// Build Table
+Wavetable::Wavetable(int waveType) {
+    for (int i = -1; i < tableSize + 2; ++i) {
+        // Guard points repeat the start and end of the cycle
+        const int index = (i + tableSize) % tableSize;
+        const double phase = static_cast<double>(index) / tableSize;
+        float value = 0.0f;
+
+        switch (waveType) {
+            case 0: // Sine
+                value = static_cast<float>(std::sin(2.0 * M_PI * phase));
+                break;
+            case 1: // Square
+                value = (phase < 0.5) ? 1.0f : -1.0f;
+                break;
+            case 2: // Sawtooth
+                value = static_cast<float>((2.0 * phase) - 1.0);
+                break;
+            default:
+                break;
+        }
+
+        table[static_cast<size_t>(i + 1)] = value;
+    }
+}
+
+// Shared Tables
+const Wavetable& Wavetable::forWaveType(int waveType) {
+    static const Wavetable tables[] = { Wavetable(0), Wavetable(1), Wavetable(2) };
+
+    jassert(juce::isPositiveAndBelow(waveType, 3));
+    return tables[waveType];
+}